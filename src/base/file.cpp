@@ -89,6 +89,25 @@ std::wstring GetFileLastModifiedDate(const std::wstring& path) {
   return std::wstring();
 }
 
+QWORD GetFileLastWriteTime(const std::wstring& path) {
+  QWORD last_write_time = 0;
+
+  HANDLE file_handle = OpenFileForGenericRead(path);
+
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    FILETIME ft_file = {0};
+    if (GetFileTime(file_handle, nullptr, nullptr, &ft_file)) {
+      ULARGE_INTEGER ul_file;
+      ul_file.LowPart = ft_file.dwLowDateTime;
+      ul_file.HighPart = ft_file.dwHighDateTime;
+      last_write_time = ul_file.QuadPart;
+    }
+    CloseHandle(file_handle);
+  }
+
+  return last_write_time;
+}
+
 QWORD GetFileSize(const std::wstring& path) {
   QWORD file_size = 0;
 
@@ -454,6 +473,90 @@ bool SaveToFile(const std::string& data, const std::wstring& path,
   return SaveToFile((LPCVOID)&data.front(), data.size(), path, take_backup);
 }
 
+// Data is flushed to the disk before returning, so that it survives a crash.
+bool AppendToFile(const std::string& data, const std::wstring& path) {
+  if (data.empty())
+    return false;
+
+  HANDLE file_handle = ::CreateFile(GetExtendedLengthPath(path).c_str(),
+                                    FILE_APPEND_DATA, 0, nullptr,
+                                    OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                                    nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD bytes_written = 0;
+  BOOL result = ::WriteFile(file_handle, &data.front(),
+                            static_cast<DWORD>(data.size()), &bytes_written,
+                            nullptr);
+  if (result)
+    result = ::FlushFileBuffers(file_handle);
+  ::CloseHandle(file_handle);
+
+  return result != FALSE && bytes_written == data.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MappedFile::MappedFile()
+    : file_(INVALID_HANDLE_VALUE), mapping_(nullptr),
+      data_(nullptr), size_(0) {
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const std::wstring& path) {
+  Close();
+
+  file_ = OpenFileForGenericRead(path);
+  if (file_ == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!::GetFileSizeEx(file_, &size) || size.QuadPart == 0 ||
+      static_cast<QWORD>(size.QuadPart) > static_cast<size_t>(-1)) {
+    Close();
+    return false;
+  }
+
+  mapping_ = ::CreateFileMapping(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_)
+    data_ = static_cast<const BYTE*>(
+        ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+
+  if (!data_) {
+    Close();
+    return false;
+  }
+
+  size_ = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_)
+    ::UnmapViewOfFile(data_);
+  if (mapping_)
+    ::CloseHandle(mapping_);
+  if (file_ != INVALID_HANDLE_VALUE)
+    ::CloseHandle(file_);
+
+  file_ = INVALID_HANDLE_VALUE;
+  mapping_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+const BYTE* MappedFile::data() const {
+  return data_;
+}
+
+size_t MappedFile::size() const {
+  return size_;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 std::wstring ToSizeString(QWORD qwSize) {
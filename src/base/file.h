@@ -28,6 +28,7 @@
 
 unsigned long GetFileAge(const std::wstring& path);
 std::wstring GetFileLastModifiedDate(const std::wstring& path);
+QWORD GetFileLastWriteTime(const std::wstring& path);
 QWORD GetFileSize(const std::wstring& path);
 QWORD GetFolderSize(const std::wstring& path, bool recursive);
 
@@ -60,9 +61,32 @@ int PopulateFolders(std::vector<std::wstring>& folder_list, const std::wstring&
 bool ReadFromFile(const std::wstring& path, std::string& output);
 bool SaveToFile(LPCVOID data, DWORD length, const std::wstring& path, bool take_backup = false);
 bool SaveToFile(const std::string& data, const std::wstring& path, bool take_backup = false);
+bool AppendToFile(const std::string& data, const std::wstring& path);
 
 std::wstring ToSizeString(QWORD qwSize);
 
+// Read-only view of a whole file, mapped into memory
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  bool Open(const std::wstring& path);
+  void Close();
+
+  const BYTE* data() const;
+  size_t size() const;
+
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  HANDLE file_;
+  HANDLE mapping_;
+  const BYTE* data_;
+  size_t size_;
+};
+
 class FileSearchHelper {
 public:
   typedef std::function<bool(const std::wstring& root, const std::wstring& name, const WIN32_FIND_DATA& data)> callback_function_t;
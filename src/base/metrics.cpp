@@ -0,0 +1,141 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "log.h"
+#include "metrics.h"
+#include "string.h"
+
+namespace base {
+
+// Zero-initialized before any metric is constructed
+static Metric* first_metric = nullptr;
+
+static double GetTicksPerMillisecond() {
+  LARGE_INTEGER frequency;
+  ::QueryPerformanceFrequency(&frequency);
+  return static_cast<double>(frequency.QuadPart) / 1000.0;
+}
+
+Metric::Metric(const wchar_t* name, Type type)
+    : name_(name), type_(type),
+      count_(0), total_(0), maximum_(0),
+      next_(first_metric) {
+  first_metric = this;
+}
+
+void Metric::Add(LONGLONG value) {
+  InterlockedIncrement64(&count_);
+  InterlockedExchangeAdd64(&total_, value);
+
+  LONGLONG maximum = maximum_;
+  while (value > maximum) {
+    LONGLONG previous = InterlockedCompareExchange64(&maximum_, value, maximum);
+    if (previous == maximum)
+      break;
+    maximum = previous;
+  }
+}
+
+void Metric::Reset() {
+  InterlockedExchange64(&count_, 0);
+  InterlockedExchange64(&total_, 0);
+  InterlockedExchange64(&maximum_, 0);
+}
+
+const wchar_t* Metric::name() const {
+  return name_;
+}
+
+Metric::Type Metric::type() const {
+  return type_;
+}
+
+LONGLONG Metric::count() const {
+  return count_;
+}
+
+LONGLONG Metric::total() const {
+  return total_;
+}
+
+LONGLONG Metric::maximum() const {
+  return maximum_;
+}
+
+std::wstring Metric::ToString() const {
+  std::wstring str = std::wstring(name_) + L": " + ToWstr(count());
+
+  switch (type_) {
+    case kCount:
+      str += L" events";
+      break;
+    case kDuration: {
+      const double ticks_per_ms = GetTicksPerMillisecond();
+      str += L" calls, " + ToWstr(total() / ticks_per_ms, 3) + L"ms total, " +
+             ToWstr(total() / ticks_per_ms / max(count(), 1LL), 4) +
+             L"ms average, " + ToWstr(maximum() / ticks_per_ms, 3) +
+             L"ms max";
+      break;
+    }
+    case kValue:
+      str += L" samples, " + ToWstr(total()) + L" total, " +
+             ToWstr(static_cast<double>(total()) / max(count(), 1LL), 2) +
+             L" average, " + ToWstr(maximum()) + L" max";
+      break;
+  }
+
+  return str;
+}
+
+Metric* Metric::first() {
+  return first_metric;
+}
+
+Metric* Metric::next() const {
+  return next_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ScopedTimer::ScopedTimer(Metric& metric)
+    : metric_(metric) {
+  ::QueryPerformanceCounter(&start_);
+}
+
+ScopedTimer::~ScopedTimer() {
+  LARGE_INTEGER end;
+  ::QueryPerformanceCounter(&end);
+  metric_.Add(end.QuadPart - start_.QuadPart);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void LogMetrics() {
+  for (auto metric = Metric::first(); metric; metric = metric->next()) {
+    if (metric->count() > 0)
+      LOG(LevelDebug, metric->ToString());
+  }
+}
+
+void ResetMetrics() {
+  for (auto metric = Metric::first(); metric; metric = metric->next()) {
+    metric->Reset();
+  }
+}
+
+}  // namespace base
\ No newline at end of file
@@ -0,0 +1,84 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_BASE_METRICS_H
+#define TAIGA_BASE_METRICS_H
+
+#include <string>
+#include <windows.h>
+
+namespace base {
+
+// A named counter that aggregates values from any thread without locking.
+// Metrics register themselves on construction, so they must be defined at
+// namespace scope, where they are created before any other thread is running.
+class Metric {
+public:
+  enum Type {
+    kCount,     // number of events
+    kDuration,  // performance counter ticks
+    kValue,     // e.g. sizes
+  };
+
+  Metric(const wchar_t* name, Type type);
+
+  void Add(LONGLONG value = 1);
+  void Reset();
+
+  const wchar_t* name() const;
+  Type type() const;
+  LONGLONG count() const;
+  LONGLONG total() const;
+  LONGLONG maximum() const;
+
+  std::wstring ToString() const;
+
+  // Iterates over all registered metrics
+  static Metric* first();
+  Metric* next() const;
+
+private:
+  const wchar_t* name_;
+  Type type_;
+  volatile LONGLONG count_;
+  volatile LONGLONG total_;
+  volatile LONGLONG maximum_;
+  Metric* next_;
+};
+
+// Adds the time that passes until the end of the scope to a duration metric
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Metric& metric);
+  ~ScopedTimer();
+
+private:
+  ScopedTimer(const ScopedTimer&);
+  ScopedTimer& operator=(const ScopedTimer&);
+
+  Metric& metric_;
+  LARGE_INTEGER start_;
+};
+
+// Writes all metrics with at least one event to the log
+void LogMetrics();
+void ResetMetrics();
+
+}  // namespace base
+
+#endif  // TAIGA_BASE_METRICS_H
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include <map>
 #include <regex>
 #include <sstream>
+#include <emmintrin.h>
 
 #include "string.h"
 
@@ -399,38 +400,356 @@ double LevenshteinDistance(const wstring& str1, const wstring& str2) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void GetTrigrams(const wstring& str, trigram_container_t& output) {
-  const size_t n = 3;
+static const StringPattern::Mask empty_mask = {0, 0};
 
-  if (n < 1)
+StringPattern::StringPattern(const wstring& str)
+    : str_(str) {
+  std::fill(std::begin(ascii_masks_), std::end(ascii_masks_), empty_mask);
+
+  if (str_.size() > kMaxLength)
     return;
 
+  for (size_t i = 0; i < str_.size(); ++i) {
+    const wchar_t c = str_[i];
+    Mask* mask = nullptr;
+    if (c < 128) {
+      mask = &ascii_masks_[c];
+    } else {
+      auto it = std::lower_bound(other_masks_.begin(), other_masks_.end(), c,
+          [](const std::pair<wchar_t, Mask>& a, wchar_t b) {
+            return a.first < b;
+          });
+      if (it == other_masks_.end() || it->first != c)
+        it = other_masks_.insert(it, std::make_pair(c, empty_mask));
+      mask = &it->second;
+    }
+    if (i < 64) {
+      mask->low |= 1ull << i;
+    } else {
+      mask->high |= 1ull << (i - 64);
+    }
+  }
+}
+
+const StringPattern::Mask& StringPattern::GetMask(const wchar_t c) const {
+  if (c < 128)
+    return ascii_masks_[c];
+
+  auto it = std::lower_bound(other_masks_.begin(), other_masks_.end(), c,
+      [](const std::pair<wchar_t, Mask>& a, wchar_t b) {
+        return a.first < b;
+      });
+  return it != other_masks_.end() && it->first == c ? it->second : empty_mask;
+}
+
+const wstring& StringPattern::str() const {
+  return str_;
+}
+
+// The bit-parallel algorithms below are written once for 64-bit and 128-bit
+// vectors. Bits above the pattern length are never read back, and since carries
+// and borrows only propagate upwards, they don't affect the lower bits.
+
+struct BitVector128 {
+  UINT64 low;
+  UINT64 high;
+};
+
+static inline UINT64 ToBitVector(const StringPattern::Mask& mask, UINT64) {
+  return mask.low;
+}
+static inline BitVector128 ToBitVector(const StringPattern::Mask& mask,
+                                       BitVector128) {
+  BitVector128 v = {mask.low, mask.high};
+  return v;
+}
+
+static inline BitVector128 operator&(BitVector128 a, BitVector128 b) {
+  BitVector128 v = {a.low & b.low, a.high & b.high};
+  return v;
+}
+static inline BitVector128 operator|(BitVector128 a, BitVector128 b) {
+  BitVector128 v = {a.low | b.low, a.high | b.high};
+  return v;
+}
+static inline BitVector128 operator^(BitVector128 a, BitVector128 b) {
+  BitVector128 v = {a.low ^ b.low, a.high ^ b.high};
+  return v;
+}
+static inline BitVector128 operator~(BitVector128 a) {
+  BitVector128 v = {~a.low, ~a.high};
+  return v;
+}
+static inline BitVector128 operator+(BitVector128 a, BitVector128 b) {
+  BitVector128 v = {a.low + b.low, a.high + b.high};
+  v.high += v.low < a.low ? 1 : 0;
+  return v;
+}
+static inline BitVector128 operator-(BitVector128 a, BitVector128 b) {
+  BitVector128 v = {a.low - b.low, a.high - b.high};
+  v.high -= a.low < b.low ? 1 : 0;
+  return v;
+}
+
+static inline UINT64 ShiftLeft(UINT64 v, UINT64 lowest_bit) {
+  return (v << 1) | lowest_bit;
+}
+static inline BitVector128 ShiftLeft(BitVector128 a, UINT64 lowest_bit) {
+  BitVector128 v = {(a.low << 1) | lowest_bit, (a.high << 1) | (a.low >> 63)};
+  return v;
+}
+
+static inline bool GetBit(UINT64 v, size_t index) {
+  return ((v >> index) & 1) != 0;
+}
+static inline bool GetBit(BitVector128 v, size_t index) {
+  return index < 64 ? GetBit(v.low, index) : GetBit(v.high, index - 64);
+}
+
+static inline UINT64 FillBits(UINT64) {
+  return ~0ull;
+}
+static inline BitVector128 FillBits(BitVector128) {
+  BitVector128 v = {~0ull, ~0ull};
+  return v;
+}
+
+template <typename T>
+static size_t BitParallelLcs(const wstring& str1, const StringPattern& str2) {
+  const size_t length = str2.str().size();
+  T v = FillBits(T());
+
+  for (size_t i = 0; i < str1.size(); ++i) {
+    const T u = v & ToBitVector(str2.GetMask(str1[i]), T());
+    v = (v + u) | (v - u);
+  }
+
+  size_t lcs_length = 0;
+  for (size_t i = 0; i < length; ++i)
+    if (!GetBit(v, i))
+      ++lcs_length;
+  return lcs_length;
+}
+
+template <typename T>
+static size_t BitParallelLevenshtein(const wstring& str1,
+                                     const StringPattern& str2) {
+  const size_t length = str2.str().size();
+  const size_t last_bit = length - 1;
+
+  T pv = FillBits(T());
+  T mv = T();
+  size_t distance = length;
+
+  for (size_t i = 0; i < str1.size(); ++i) {
+    const T eq = ToBitVector(str2.GetMask(str1[i]), T());
+    const T xv = eq | mv;
+    const T xh = (((eq & pv) + pv) ^ pv) | eq;
+    T ph = mv | ~(xh | pv);
+    T mh = pv & xh;
+    if (GetBit(ph, last_bit)) {
+      ++distance;
+    } else if (GetBit(mh, last_bit)) {
+      --distance;
+    }
+    // The first row of the distance matrix increases by one in each column
+    ph = ShiftLeft(ph, 1);
+    mh = ShiftLeft(mh, 0);
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+  }
+
+  return distance;
+}
+
+size_t LongestCommonSubsequenceLength(const wstring& str1,
+                                      const StringPattern& str2) {
+  const size_t length = str2.str().size();
+
+  if (str1.empty() || length == 0)
+    return 0;
+  if (length > StringPattern::kMaxLength)
+    return LongestCommonSubsequenceLength(str1, str2.str());
+
+  return length <= 64 ? BitParallelLcs<UINT64>(str1, str2) :
+                        BitParallelLcs<BitVector128>(str1, str2);
+}
+
+// Same as the function above, with the flags kept on the stack for strings
+// that are short enough.
+double JaroWinklerDistance(const wstring& str1, const StringPattern& str2) {
+  const wstring& str = str2.str();
+  const int max_length = 256;
+  const int len1 = str1.size();
+  const int len2 = str.size();
+
+  if (!len1 || !len2)
+    return 0.0;
+  if (len1 > max_length || len2 > max_length)
+    return JaroWinklerDistance(str1, str);
+
+  int i, j, l;
+  int m = 0, t = 0;
+  bool sflags[max_length] = {false};
+  bool aflags[max_length] = {false};
+
+  // Calculate matching characters
+  int range = max(0, (max(len1, len2) / 2) - 1);
+  for (i = 0; i < len2; i++) {
+    for (j = max(i - range, 0), l = min(i + range + 1, len1); j < l; j++) {
+      if (str[i] == str1[j] && !sflags[j]) {
+        sflags[j] = true;
+        aflags[i] = true;
+        m++;
+        break;
+      }
+    }
+  }
+  if (!m)
+    return 0.0;
+
+  // Calculate character transpositions
+  l = 0;
+  for (i = 0; i < len2; i++) {
+    if (aflags[i]) {
+      for (j = l; j < len1; j++) {
+        if (sflags[j]) {
+          l = j + 1;
+          break;
+        }
+      }
+      if (str[i] != str1[j])
+        t++;
+    }
+  }
+  t /= 2;
+
+  // Jaro distance
+  double dw = ((static_cast<double>(m) / len1) +
+               (static_cast<double>(m) / len2) +
+               (static_cast<double>(m - t) / m)) / 3.0;
+
+  // Calculate common string prefix up to 4 chars
+  l = 0;
+  for (i = 0; i < min(min(len1, len2), 4); i++)
+    if (str1[i] == str[i])
+        l++;
+
+  // Jaro-Winkler distance
+  const double scaling_factor = 0.1;
+  dw = dw + (l * scaling_factor * (1.0 - dw));
+
+  return dw;
+}
+
+double LevenshteinDistance(const wstring& str1, const StringPattern& str2) {
+  const size_t length = str2.str().size();
+
+  if (length == 0 || length > StringPattern::kMaxLength)
+    return LevenshteinDistance(str1, str2.str());
+
+  const size_t distance = length <= 64 ?
+      BitParallelLevenshtein<UINT64>(str1, str2) :
+      BitParallelLevenshtein<BitVector128>(str1, str2);
+
+  const double len = static_cast<double>(max(str1.size(), length));
+  return 1.0 - (distance / len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+trigram_t PackTrigram(const wchar_t c1, const wchar_t c2, const wchar_t c3) {
+  return (static_cast<trigram_t>(static_cast<WORD>(c1)) << 32) |
+         (static_cast<trigram_t>(static_cast<WORD>(c2)) << 16) |
+         static_cast<trigram_t>(static_cast<WORD>(c3));
+}
+
+void GetTrigrams(const wstring& str, trigram_container_t& output) {
+  const size_t n = 3;
+
   output.clear();
 
   if (n >= str.size()) {
-    trigram_t buffer = {'\0'};
-    std::copy(str.begin(), str.end(), buffer.begin());
-    output.push_back(buffer);
+    wchar_t buffer[n] = {'\0'};
+    std::copy(str.begin(), str.end(), buffer);
+    output.push_back(PackTrigram(buffer[0], buffer[1], buffer[2]));
     return;
   }
 
-  for (size_t i = 0; i <= str.size() - n; ++i) {
-    trigram_t buffer = {'\0'};
-    std::copy(str.begin() + i, str.begin() + (i + n), buffer.begin());
-    output.push_back(buffer);
-  }
+  output.reserve(str.size() - n + 1);
+  for (size_t i = 0; i <= str.size() - n; ++i)
+    output.push_back(PackTrigram(str[i], str[i + 1], str[i + 2]));
 
   std::sort(output.begin(), output.end());
+
+  // Tag repeated trigrams with their occurrence count, then restore the order
+  bool has_duplicates = false;
+  trigram_t occurrence = 0;
+  for (size_t i = 1; i < output.size(); ++i) {
+    if (output[i] == (output[i - 1] & 0xFFFFFFFFFFFFull)) {
+      occurrence += 1ull << 48;
+      output[i] |= occurrence;
+      has_duplicates = true;
+    } else {
+      occurrence = 0;
+    }
+  }
+  if (has_duplicates)
+    std::sort(output.begin(), output.end());
+}
+
+size_t CountCommonTrigrams(const trigram_container_t& t1,
+                           const trigram_container_t& t2) {
+  auto it1 = t1.begin(), end1 = t1.end();
+  auto it2 = t2.begin(), end2 = t2.end();
+  size_t count = 0;
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+    defined(__SSE2__)
+  // Compare two values from each side at once. SSE2 lacks a 64-bit equality
+  // comparison, so we combine the results of the 32-bit one.
+  auto cmpeq_epi64 = [](__m128i a, __m128i b) {
+    __m128i result = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(result,
+                         _mm_shuffle_epi32(result, _MM_SHUFFLE(2, 3, 0, 1)));
+  };
+
+  while (end1 - it1 >= 2 && end2 - it2 >= 2) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&*it1));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&*it2));
+    __m128i b_swapped = _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128i matches = _mm_or_si128(cmpeq_epi64(a, b),
+                                   cmpeq_epi64(a, b_swapped));
+    int mask = _mm_movemask_pd(_mm_castsi128_pd(matches));
+    count += (mask & 1) + (mask >> 1);
+
+    const trigram_t a_max = *(it1 + 1);
+    const trigram_t b_max = *(it2 + 1);
+    if (a_max <= b_max)
+      it1 += 2;
+    if (b_max <= a_max)
+      it2 += 2;
+  }
+#endif
+
+  while (it1 != end1 && it2 != end2) {
+    if (*it1 < *it2) {
+      ++it1;
+    } else if (*it2 < *it1) {
+      ++it2;
+    } else {
+      ++count;
+      ++it1;
+      ++it2;
+    }
+  }
+
+  return count;
 }
 
 double CompareTrigrams(const trigram_container_t& t1,
                        const trigram_container_t& t2) {
-  trigram_container_t intersection;
-
-  std::set_intersection(t1.begin(), t1.end(), t2.begin(), t2.end(),
-                        std::back_inserter(intersection));
-
-  return static_cast<double>(intersection.size()) /
+  return static_cast<double>(CountCommonTrigrams(t1, t2)) /
          static_cast<double>(max(t1.size(), t2.size()));
 }
 
@@ -63,9 +63,43 @@ size_t LongestCommonSubstringLength(const std::wstring& str1, const std::wstring
 double JaroWinklerDistance(const std::wstring& str1, const std::wstring& str2);
 double LevenshteinDistance(const std::wstring& str1, const std::wstring& str2);
 
-typedef std::array<wchar_t, 3> trigram_t;
+// Precomputed character masks of a string, for comparing it against many other
+// strings with bit-parallel algorithms (Myers/Hyyro for edit distance, Allison-
+// Dix for LCS). Strings longer than kMaxLength fall back to the functions above,
+// which also serve as the reference implementations.
+class StringPattern {
+public:
+  struct Mask {
+    UINT64 low;
+    UINT64 high;
+  };
+
+  static const size_t kMaxLength = 128;
+
+  explicit StringPattern(const std::wstring& str);
+
+  const Mask& GetMask(const wchar_t c) const;
+  const std::wstring& str() const;
+
+private:
+  std::wstring str_;
+  Mask ascii_masks_[128];
+  std::vector<std::pair<wchar_t, Mask>> other_masks_;  // sorted by character
+};
+
+size_t LongestCommonSubsequenceLength(const std::wstring& str1, const StringPattern& str2);
+double JaroWinklerDistance(const std::wstring& str1, const StringPattern& str2);
+double LevenshteinDistance(const std::wstring& str1, const StringPattern& str2);
+
+// Three UTF-16 code units packed into the lower 48 bits, with the upper 16
+// bits holding the occurrence count of the same trigram within the string.
+// The latter makes each value unique, so that multiset intersections can be
+// calculated with a plain sorted-set intersection.
+typedef UINT64 trigram_t;
 typedef std::vector<trigram_t> trigram_container_t;
+trigram_t PackTrigram(const wchar_t c1, const wchar_t c2, const wchar_t c3);
 void GetTrigrams(const std::wstring& str, trigram_container_t& output);
+size_t CountCommonTrigrams(const trigram_container_t& t1, const trigram_container_t& t2);
 double CompareTrigrams(const trigram_container_t& t1, const trigram_container_t& t2);
 
 void ReplaceChar(std::wstring& str, const wchar_t c, const wchar_t replace_with);
@@ -0,0 +1,152 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "library/anime_columns.h"
+#include "library/anime_db.h"
+#include "library/anime_item.h"
+
+namespace anime {
+
+// Beyond this many invalid items, reading every item again is faster than
+// inserting and erasing rows one by one.
+static const size_t kMaxInvalidIds = 64;
+
+size_t ItemColumns::Columns::Find(int anime_id) const {
+  auto it = std::lower_bound(anime_ids.begin(), anime_ids.end(), anime_id);
+  if (it == anime_ids.end() || *it != anime_id)
+    return npos;
+
+  return it - anime_ids.begin();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ItemColumns::ItemColumns()
+    : invalid_all_(true) {
+}
+
+const ItemColumns::Columns& ItemColumns::Get() {
+  if (invalid_all_ || !invalid_ids_.empty())
+    Refresh();
+
+  return columns_;
+}
+
+void ItemColumns::Invalidate(int anime_id) {
+  if (!invalid_all_)
+    invalid_ids_.insert(anime_id);
+}
+
+void ItemColumns::InvalidateAll() {
+  invalid_all_ = true;
+  invalid_ids_.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ItemColumns::Erase(size_t row) {
+  columns_.anime_ids.erase(columns_.anime_ids.begin() + row);
+  columns_.types.erase(columns_.types.begin() + row);
+  columns_.airing_statuses.erase(columns_.airing_statuses.begin() + row);
+  columns_.episode_counts.erase(columns_.episode_counts.begin() + row);
+  columns_.episode_lengths.erase(columns_.episode_lengths.begin() + row);
+  columns_.popularities.erase(columns_.popularities.begin() + row);
+  columns_.scores.erase(columns_.scores.begin() + row);
+  columns_.date_starts.erase(columns_.date_starts.begin() + row);
+  columns_.in_list.erase(columns_.in_list.begin() + row);
+  columns_.my_statuses.erase(columns_.my_statuses.begin() + row);
+  columns_.my_scores.erase(columns_.my_scores.begin() + row);
+  columns_.my_last_watched_episodes.erase(
+      columns_.my_last_watched_episodes.begin() + row);
+  columns_.my_rewatched_times.erase(columns_.my_rewatched_times.begin() + row);
+  columns_.my_rewatching.erase(columns_.my_rewatching.begin() + row);
+}
+
+void ItemColumns::Insert(size_t row, const Item& item) {
+  columns_.anime_ids.insert(columns_.anime_ids.begin() + row, item.GetId());
+  columns_.types.insert(columns_.types.begin() + row, 0);
+  columns_.airing_statuses.insert(columns_.airing_statuses.begin() + row, 0);
+  columns_.episode_counts.insert(columns_.episode_counts.begin() + row, 0);
+  columns_.episode_lengths.insert(columns_.episode_lengths.begin() + row, 0);
+  columns_.popularities.insert(columns_.popularities.begin() + row, 0);
+  columns_.scores.insert(columns_.scores.begin() + row, 0.0);
+  columns_.date_starts.insert(columns_.date_starts.begin() + row, Date());
+  columns_.in_list.insert(columns_.in_list.begin() + row, false);
+  columns_.my_statuses.insert(columns_.my_statuses.begin() + row, 0);
+  columns_.my_scores.insert(columns_.my_scores.begin() + row, 0);
+  columns_.my_last_watched_episodes.insert(
+      columns_.my_last_watched_episodes.begin() + row, 0);
+  columns_.my_rewatched_times.insert(
+      columns_.my_rewatched_times.begin() + row, 0);
+  columns_.my_rewatching.insert(columns_.my_rewatching.begin() + row, false);
+
+  Set(row, item);
+}
+
+void ItemColumns::Set(size_t row, const Item& item) {
+  columns_.types.at(row) = item.GetType();
+  columns_.airing_statuses.at(row) = item.GetAiringStatus(false);
+  columns_.episode_counts.at(row) = item.GetEpisodeCount();
+  columns_.episode_lengths.at(row) = item.GetEpisodeLength();
+  columns_.popularities.at(row) = item.GetPopularity();
+  columns_.scores.at(row) = item.GetScore();
+  columns_.date_starts.at(row) = item.GetDateStart();
+  columns_.in_list.at(row) = item.IsInList();
+  columns_.my_statuses.at(row) = item.GetMyStatus();
+  columns_.my_scores.at(row) = item.GetMyScore();
+  columns_.my_last_watched_episodes.at(row) = item.GetMyLastWatchedEpisode();
+  columns_.my_rewatched_times.at(row) = item.GetMyRewatchedTimes();
+  columns_.my_rewatching.at(row) = item.GetMyRewatching() != FALSE;
+}
+
+void ItemColumns::Refresh() {
+  if (invalid_all_ || invalid_ids_.size() > kMaxInvalidIds) {
+    columns_ = Columns();
+    // Items are sorted by ID, and so are the rows
+    for (const auto& it : AnimeDatabase.items)
+      if (it.first == it.second.GetId())
+        Insert(columns_.anime_ids.size(), it.second);
+    invalid_all_ = false;
+
+  } else {
+    for (const auto& anime_id : invalid_ids_) {
+      size_t row = columns_.Find(anime_id);
+      auto it = AnimeDatabase.items.find(anime_id);
+      const bool found = it != AnimeDatabase.items.end() &&
+                         it->second.GetId() == anime_id;
+      if (row != Columns::npos) {
+        if (found) {
+          Set(row, it->second);
+        } else {
+          Erase(row);
+        }
+      } else if (found) {
+        row = std::lower_bound(columns_.anime_ids.begin(),
+                               columns_.anime_ids.end(), anime_id) -
+              columns_.anime_ids.begin();
+        Insert(row, it->second);
+      }
+    }
+  }
+
+  invalid_ids_.clear();
+}
+
+}  // namespace anime
\ No newline at end of file
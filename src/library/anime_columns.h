@@ -0,0 +1,80 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_LIBRARY_ANIME_COLUMNS_H
+#define TAIGA_LIBRARY_ANIME_COLUMNS_H
+
+#include <set>
+#include <vector>
+
+#include "base/time.h"
+
+namespace anime {
+
+class Item;
+
+// Frequently compared fields of every item, stored as a structure of arrays
+// sorted by anime ID, so that sorting, filtering and statistics can scan them
+// without visiting each item. Library values take the history queue into
+// account, as the item getters do by default. Items that are marked as invalid
+// are read again on the next access.
+class ItemColumns {
+public:
+  struct Columns {
+    static const size_t npos = static_cast<size_t>(-1);
+
+    // Returns the row of an anime, or npos if it is not in the database
+    size_t Find(int anime_id) const;
+
+    std::vector<int> anime_ids;
+    std::vector<int> types;
+    std::vector<int> airing_statuses;  // as stored, without checking dates
+    std::vector<int> episode_counts;
+    std::vector<int> episode_lengths;
+    std::vector<int> popularities;
+    std::vector<double> scores;
+    std::vector<Date> date_starts;
+    std::vector<char> in_list;
+    std::vector<int> my_statuses;
+    std::vector<int> my_scores;
+    std::vector<int> my_last_watched_episodes;
+    std::vector<int> my_rewatched_times;
+    std::vector<char> my_rewatching;
+  };
+
+  ItemColumns();
+
+  const Columns& Get();
+
+  void Invalidate(int anime_id);
+  void InvalidateAll();
+
+private:
+  void Erase(size_t row);
+  void Insert(size_t row, const Item& item);
+  void Set(size_t row, const Item& item);
+  void Refresh();
+
+  Columns columns_;
+  std::set<int> invalid_ids_;
+  bool invalid_all_;
+};
+
+}  // namespace anime
+
+#endif  // TAIGA_LIBRARY_ANIME_COLUMNS_H
\ No newline at end of file
@@ -44,7 +44,18 @@ anime::Database AnimeDatabase;
 
 namespace anime {
 
+Database::Database()
+    : list_journal_entries_(0),
+      list_journal_valid_(false) {
+}
+
 bool Database::LoadDatabase() {
+  if (LoadSnapshot()) {
+    text_index.InvalidateAll();
+    columns.InvalidateAll();
+    return true;
+  }
+
   xml_document document;
   std::wstring path = taiga::GetPath(taiga::kPathDatabaseAnime);
   unsigned int options = pugi::parse_default & ~pugi::parse_eol;
@@ -65,6 +76,9 @@ bool Database::LoadDatabase() {
     ReadDatabaseInCompatibilityMode(document);
   }
 
+  text_index.InvalidateAll();
+  columns.InvalidateAll();
+
   return true;
 }
 
@@ -121,7 +135,7 @@ void Database::ReadDatabaseNode(xml_node& database_node) {
     item.SetEpisodeLength(XmlReadIntValue(node, L"episode_length"));  // extent(1)
     item.SetEpisodeCount(XmlReadIntValue(node, L"episode_count"));    // extent(0)
     item.SetSlug(XmlReadStrValue(node, L"slug"));       // resource(1)
-    item.SetImageUrl(XmlReadStrValue(node, L"image"));  // resource(0)
+    item.SetImageUrl(XmlReadStrValue(node, L"image"));
   }
 }
 
@@ -139,8 +153,11 @@ bool Database::SaveDatabase() {
 }
 
 void Database::WriteDatabaseNode(xml_node& database_node) {
+  Item::ColdFields buffer;
+
   foreach_(it, items) {
     xml_node anime_node = database_node.append_child(L"anime");
+    const auto& cold_fields = GetColdFields(it->second, buffer);
 
     for (int i = 0; i <= sync::kLastService; i++) {
       std::wstring id = it->second.GetId(i);
@@ -176,13 +193,13 @@ void Database::WriteDatabaseNode(xml_node& database_node) {
     XML_WI(L"episode_length", it->second.GetEpisodeLength());
     XML_WD(L"date_start", it->second.GetDateStart());
     XML_WD(L"date_end", it->second.GetDateEnd());
-    XML_WS(L"image", it->second.GetImageUrl(), pugi::node_pcdata);
+    XML_WS(L"image", cold_fields.image_url, pugi::node_pcdata);
     XML_WI(L"age_rating", it->second.GetAgeRating());
     XML_WS(L"genres", Join(it->second.GetGenres(), L", "), pugi::node_pcdata);
-    XML_WS(L"producers", Join(it->second.GetProducers(), L", "), pugi::node_pcdata);
+    XML_WS(L"producers", Join(cold_fields.producers, L", "), pugi::node_pcdata);
     XML_WF(L"score", it->second.GetScore(), pugi::node_pcdata);
     XML_WI(L"popularity", it->second.GetPopularity());
-    XML_WS(L"synopsis", it->second.GetSynopsis(), pugi::node_cdata);
+    XML_WS(L"synopsis", cold_fields.synopsis, pugi::node_cdata);
     XML_WS(L"modified", ToWstr(it->second.GetLastModified()), pugi::node_pcdata);
     #undef XML_WF
     #undef XML_WS
@@ -209,9 +226,14 @@ Item* Database::FindItem(int id, bool log_error) {
 Item* Database::FindItem(const std::wstring& id, enum_t service,
                          bool log_error) {
   if (!id.empty()) {
-    foreach_(it, items)
-      if (id == it->second.GetId(service))
-        return &it->second;
+    auto& id_index = id_indexes_[service];
+    auto it = id_index.find(id);
+    if (it != id_index.end()) {
+      auto item = FindItem(it->second, false);
+      if (item && item->GetId(service) == id)
+        return item;
+      id_index.erase(it);  // the item was removed without notice
+    }
     if (log_error)
       LOG(LevelError, L"Could not find ID: " + id);
   }
@@ -225,8 +247,13 @@ void Database::ClearInvalidItems() {
   for (auto it = items.begin(); it != items.end(); ) {
     if (!anime::IsValidId(it->second.GetId()) ||
         it->first != it->second.GetId()) {
-      LOG(LevelDebug, L"ID: " + ToWstr(it->first));
+      const int anime_id = it->first;
+      LOG(LevelDebug, L"ID: " + ToWstr(anime_id));
+      RemoveFromIdIndex(anime_id, it->second);
       items.erase(it++);
+      text_index.Invalidate(anime_id);
+      columns.Invalidate(anime_id);
+      Meow.UpdateFacts(anime_id);
     } else {
       ++it;
     }
@@ -237,12 +264,18 @@ bool Database::DeleteItem(int id) {
   std::wstring title;
 
   auto anime_item = FindItem(id, false);
-  if (anime_item)
+  if (anime_item) {
     title = anime_item->GetTitle();
+    RemoveFromIdIndex(id, *anime_item);
+  }
 
   if (items.erase(id) > 0) {
     LOG(LevelWarning, L"ID: " + ToWstr(id) + L" | Title: " + title);
 
+    text_index.Invalidate(id);
+    columns.Invalidate(id);
+    Meow.UpdateFacts(id);
+
     auto delete_history_items = [](int id, std::vector<HistoryItem>& items) {
       items.erase(std::remove_if(items.begin(), items.end(),
           [&id](const HistoryItem& item) {
@@ -252,6 +285,7 @@ bool Database::DeleteItem(int id) {
 
     delete_history_items(id, History.items);
     delete_history_items(id, History.queue.items);
+    History.queue.InvalidateSearchIndex();
 
     auto& items = SeasonDatabase.items;
     items.erase(std::remove(items.begin(), items.end(), id), items.end());
@@ -266,6 +300,43 @@ bool Database::DeleteItem(int id) {
   return false;
 }
 
+void Database::UpdateIdIndex(const Item& item, enum_t service,
+                             const std::wstring& previous_id) {
+  // Items that are not in the database (e.g. the ones that are created while
+  // parsing a service response) are not indexed.
+  const int anime_id = item.GetId();
+  auto it = items.find(anime_id);
+  if (it == items.end() || &it->second != &item)
+    return;
+
+  if (!previous_id.empty()) {
+    auto& id_index = id_indexes_[service];
+    auto previous = id_index.find(previous_id);
+    if (previous != id_index.end() && previous->second == anime_id)
+      id_index.erase(previous);
+  }
+
+  // Other IDs might have been set before the item got its Taiga ID
+  AddToIdIndex(anime_id, item);
+}
+
+void Database::AddToIdIndex(int anime_id, const Item& item) {
+  for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++) {
+    const auto& id = item.GetId(i);
+    if (!id.empty())
+      id_indexes_[i][id] = anime_id;
+  }
+}
+
+void Database::RemoveFromIdIndex(int anime_id, const Item& item) {
+  for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++) {
+    auto& id_index = id_indexes_[i];
+    auto it = id_index.find(item.GetId(i));
+    if (it != id_index.end() && it->second == anime_id)
+      id_index.erase(it);
+  }
+}
+
 int Database::UpdateItem(const Item& new_item) {
   Item* item = nullptr;
 
@@ -367,6 +438,8 @@ int Database::UpdateItem(const Item& new_item) {
     item->SetMyTags(new_item.GetMyTags(false));
   }
 
+  Meow.UpdateFacts(item->GetId());
+
   return item->GetId();
 }
 
@@ -425,6 +498,8 @@ bool Database::LoadList() {
     ReadListInCompatibilityMode(document);
   }
 
+  LoadListJournal();
+
   return true;
 }
 
@@ -463,7 +538,11 @@ bool Database::SaveList(bool include_database) {
   }
 
   std::wstring path = taiga::GetPath(taiga::kPathUserLibrary);
-  return XmlWriteDocumentToFile(document, path);
+  if (!XmlWriteDocumentToFile(document, path))
+    return false;
+
+  ResetListJournal();
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -533,7 +612,7 @@ void Database::AddToList(int anime_id, int status) {
   History.queue.Add(history_item);
 
   SaveDatabase();
-  SaveList();
+  SaveListEntry(anime_id);
 
   ui::OnLibraryEntryAdd(anime_id);
 
@@ -544,6 +623,9 @@ void Database::AddToList(int anime_id, int status) {
 void Database::ClearUserData() {
   foreach_(it, items)
     it->second.RemoveFromUserList();
+
+  text_index.InvalidateAll();
+  columns.InvalidateAll();
 }
 
 bool Database::DeleteListItem(int anime_id) {
@@ -609,7 +691,7 @@ void Database::UpdateItem(const HistoryItem& history_item) {
   if (history_item.mode != taiga::kHttpServiceDeleteLibraryEntry)
     anime::SetMyLastUpdateToNow(*anime_item);
 
-  SaveList();
+  SaveListEntry(history_item.anime_id);
 
   History.queue.Remove();
   History.queue.Check(false);
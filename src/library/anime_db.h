@@ -20,8 +20,12 @@
 #define TAIGA_LIBRARY_ANIME_DB_H
 
 #include <map>
+#include <string>
+#include <unordered_map>
 
+#include "library/anime_columns.h"
 #include "library/anime_item.h"
+#include "library/anime_text_index.h"
 
 class HistoryItem;
 namespace pugi {
@@ -33,8 +37,11 @@ namespace anime {
 
 class Database {
 public:
+  Database();
+
   bool LoadDatabase();
   bool SaveDatabase();
+  bool SaveSnapshot();
 
   Item* FindItem(int id, bool log_error = true);
   Item* FindItem(const std::wstring& id, enum_t service, bool log_error = true);
@@ -43,9 +50,15 @@ public:
   bool DeleteItem(int id);
   int UpdateItem(const Item& item);
 
+  // Called by Item::SetId to keep the ID index up to date
+  void UpdateIdIndex(const Item& item, enum_t service,
+                     const std::wstring& previous_id);
+
 public:
   bool LoadList();
   bool SaveList(bool include_database = false);
+  bool SaveListEntry(int anime_id);
+  bool CompactListJournal();
 
   int GetItemCount(int status, bool check_history = true);
 
@@ -56,8 +69,35 @@ public:
 
 public:
   std::map<int, Item> items;
+  ItemColumns columns;
+  TextIndex text_index;
 
 private:
+  friend class Item;
+
+  bool LoadListJournal();
+  bool ResetListJournal();
+
+  bool LoadSnapshot();
+  static bool ReadSnapshotFields(const Item& item, Item::ColdFields& fields);
+  // Returns the cold fields of an item without keeping them decoded
+  static const Item::ColdFields& GetColdFields(const Item& item,
+                                               Item::ColdFields& buffer);
+
+  void AddToIdIndex(int anime_id, const Item& item);
+  void RemoveFromIdIndex(int anime_id, const Item& item);
+
+  // Maps service IDs to anime IDs for each service, so that items can be
+  // found without walking through the whole database
+  typedef std::unordered_map<std::wstring, int> id_index_t;
+  std::map<enum_t, id_index_t> id_indexes_;
+
+  // Number of entries in the list journal since the list was last saved
+  size_t list_journal_entries_;
+  // Whether the journal on disk belongs to the current list file, and can be
+  // appended to
+  bool list_journal_valid_;
+
   void ReadDatabaseNode(pugi::xml_node& database_node);
   void WriteDatabaseNode(pugi::xml_node& database_node);
 
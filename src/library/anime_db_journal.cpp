@@ -0,0 +1,250 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+
+#include "base/file.h"
+#include "base/log.h"
+#include "library/anime_db.h"
+#include "taiga/path.h"
+
+namespace anime {
+
+// Rewriting the whole list after every change is expensive, so single entries
+// are appended to a journal next to the list file instead. The journal is
+// replayed after the list is read, and emptied whenever the list is saved.
+//
+// Layout (native byte order, strings are prefixed with their length):
+//   header:  signature, format version, list time
+//   entry:   size, anime ID, in list, and if the item is in list: progress,
+//            score, status, rewatched times, rewatching, rewatching episode,
+//            start date, finish date, tags, last updated
+//
+// The list time is when the list file was last written. A journal that does
+// not belong to the current list file is ignored, and so is an entry that was
+// not written completely. Either way, the list is saved right away, so that
+// new entries are never appended to a journal that cannot be replayed.
+
+static const uint32_t kJournalSignature = 0x4C4E4A54;  // "TJNL"
+static const uint32_t kJournalVersion = 1;
+
+// The list is saved and the journal is emptied after this many entries
+static const size_t kMaxJournalEntries = 100;
+
+template <typename T>
+static void WriteValue(std::string& data, const T& value) {
+  data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void WriteString(std::string& data, const std::wstring& str) {
+  WriteValue(data, static_cast<uint32_t>(str.size()));
+  data.append(reinterpret_cast<const char*>(str.data()),
+              str.size() * sizeof(wchar_t));
+}
+
+static void WriteDate(std::string& data, const Date& date) {
+  WriteValue(data, static_cast<uint16_t>(date.year));
+  WriteValue(data, static_cast<uint16_t>(date.month));
+  WriteValue(data, static_cast<uint16_t>(date.day));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Database::LoadListJournal() {
+  list_journal_entries_ = 0;
+  list_journal_valid_ = false;
+
+  const auto list_time =
+      GetFileLastWriteTime(taiga::GetPath(taiga::kPathUserLibrary));
+  const auto path = taiga::GetPath(taiga::kPathUserLibraryJournal);
+
+  std::string data;
+  if (!list_time || !FileExists(path) || !ReadFromFile(path, data))
+    return false;
+
+  size_t position = 0;
+  size_t end = data.size();
+
+  auto read = [&](void* output, size_t length) {
+    if (length > end - position)
+      return false;
+    memcpy(output, data.data() + position, length);
+    position += length;
+    return true;
+  };
+  auto read_int = [&](int& value) {
+    int32_t number = 0;
+    if (!read(&number, sizeof(number)))
+      return false;
+    value = number;
+    return true;
+  };
+  auto read_string = [&](std::wstring& str) {
+    uint32_t length = 0;
+    if (!read(&length, sizeof(length)) ||
+        length > (end - position) / sizeof(wchar_t))
+      return false;
+    str.resize(length);
+    return length == 0 || read(&str[0], length * sizeof(wchar_t));
+  };
+  auto read_date = [&](Date& date) {
+    uint16_t values[3] = {0};
+    if (!read(values, sizeof(values)))
+      return false;
+    date = Date(values[0], values[1], values[2]);
+    return true;
+  };
+
+  uint32_t signature = 0;
+  uint32_t version = 0;
+  QWORD journal_list_time = 0;
+  if (!read(&signature, sizeof(signature)) ||
+      signature != kJournalSignature ||
+      !read(&version, sizeof(version)) || version != kJournalVersion ||
+      !read(&journal_list_time, sizeof(journal_list_time)) ||
+      journal_list_time != list_time) {
+    LOG(LevelWarning, L"Discarding invalid or outdated list journal.");
+    SaveList();
+    return false;
+  }
+
+  for (;;) {
+    uint32_t size = 0;
+    if (!read(&size, sizeof(size)) || size > data.size() - position)
+      break;
+    const size_t next_entry = position + size;
+    end = next_entry;
+
+    int anime_id = 0;
+    int in_list = 0;
+    int progress = 0, score = 0, status = 0;
+    int rewatched_times = 0, rewatching = 0, rewatching_ep = 0;
+    Date date_start, date_finish;
+    std::wstring tags, last_updated;
+    if (!read_int(anime_id) || !read_int(in_list))
+      break;
+    if (in_list &&
+        (!read_int(progress) || !read_int(score) || !read_int(status) ||
+         !read_int(rewatched_times) || !read_int(rewatching) ||
+         !read_int(rewatching_ep) ||
+         !read_date(date_start) || !read_date(date_finish) ||
+         !read_string(tags) || !read_string(last_updated)))
+      break;
+
+    position = next_entry;
+    end = data.size();
+    ++list_journal_entries_;
+
+    auto anime_item = FindItem(anime_id, false);
+    if (!anime_item)
+      continue;
+
+    if (!in_list) {
+      anime_item->RemoveFromUserList();
+      continue;
+    }
+
+    anime_item->AddtoUserList();
+    anime_item->SetMyLastWatchedEpisode(progress);
+    anime_item->SetMyDateStart(date_start);
+    anime_item->SetMyDateEnd(date_finish);
+    anime_item->SetMyScore(score);
+    anime_item->SetMyStatus(status);
+    anime_item->SetMyRewatchedTimes(rewatched_times);
+    anime_item->SetMyRewatching(rewatching);
+    anime_item->SetMyRewatchingEp(rewatching_ep);
+    anime_item->SetMyTags(tags);
+    anime_item->SetMyLastUpdated(last_updated);
+  }
+
+  if (position < data.size()) {
+    LOG(LevelWarning, L"Ignoring incomplete list journal entry.");
+    SaveList();  // includes the entries that were replayed
+  } else {
+    list_journal_valid_ = true;
+  }
+
+  return true;
+}
+
+bool Database::ResetListJournal() {
+  list_journal_entries_ = 0;
+  list_journal_valid_ = false;
+
+  const auto list_time =
+      GetFileLastWriteTime(taiga::GetPath(taiga::kPathUserLibrary));
+  if (!list_time)
+    return false;
+
+  std::string data;
+  WriteValue(data, kJournalSignature);
+  WriteValue(data, kJournalVersion);
+  WriteValue(data, list_time);
+
+  list_journal_valid_ =
+      SaveToFile(data, taiga::GetPath(taiga::kPathUserLibraryJournal));
+  return list_journal_valid_;
+}
+
+bool Database::SaveListEntry(int anime_id) {
+  auto anime_item = FindItem(anime_id, false);
+
+  if (!anime_item || list_journal_entries_ >= kMaxJournalEntries)
+    return SaveList();
+
+  std::string entry;
+  WriteValue(entry, static_cast<int32_t>(anime_id));
+  WriteValue(entry, static_cast<int32_t>(anime_item->IsInList()));
+  if (anime_item->IsInList()) {
+    WriteValue(entry, static_cast<int32_t>(anime_item->GetMyLastWatchedEpisode(false)));
+    WriteValue(entry, static_cast<int32_t>(anime_item->GetMyScore(false)));
+    WriteValue(entry, static_cast<int32_t>(anime_item->GetMyStatus(false)));
+    WriteValue(entry, static_cast<int32_t>(anime_item->GetMyRewatchedTimes()));
+    WriteValue(entry, static_cast<int32_t>(anime_item->GetMyRewatching(false)));
+    WriteValue(entry, static_cast<int32_t>(anime_item->GetMyRewatchingEp()));
+    WriteDate(entry, anime_item->GetMyDateStart());
+    WriteDate(entry, anime_item->GetMyDateEnd());
+    WriteString(entry, anime_item->GetMyTags(false));
+    WriteString(entry, anime_item->GetMyLastUpdated());
+  }
+
+  std::string data;
+  WriteValue(data, static_cast<uint32_t>(entry.size()));
+  data.append(entry);
+
+  // The journal must belong to the current list file, so the whole list is
+  // saved if there is no valid journal yet. A failed append might have left a
+  // partial entry behind, so the journal is started over in that case too.
+  const auto path = taiga::GetPath(taiga::kPathUserLibraryJournal);
+  if (!list_journal_valid_ || !AppendToFile(data, path)) {
+    list_journal_valid_ = false;
+    return SaveList();
+  }
+
+  ++list_journal_entries_;
+  return true;
+}
+
+bool Database::CompactListJournal() {
+  if (list_journal_entries_ == 0)
+    return false;
+
+  return SaveList();
+}
+
+}  // namespace anime
\ No newline at end of file
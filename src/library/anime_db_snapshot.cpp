@@ -0,0 +1,506 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <unordered_map>
+
+#include <zlib/zlib.h>
+
+#include "base/file.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "library/anime_db.h"
+#include "sync/service.h"
+#include "taiga/path.h"
+
+namespace anime {
+
+// Reading db\anime.xml means parsing every node and copying every value, which
+// takes a while with a large database. So a binary snapshot of the database is
+// written next to it on exit, and read instead if it is up to date. Fields that
+// are rarely used (image URL, producers, synopsis) are kept in a separate
+// section. The file stays mapped, and they are only decoded from the mapping
+// when the item is first asked about them.
+//
+// While mapped, the file cannot be replaced, so a new snapshot is written to a
+// temporary file that takes its place the next time it is loaded.
+//
+// Layout (native byte order, strings are prefixed with their length):
+//   header:  signature, format version, database time, string count,
+//            cold section size and checksum, item count
+//   strings: every distinct string of the item section, index 0 is empty
+//   cold:    image URL, producer count, producers, synopsis
+//   item:    record, synonym count, synonyms, genre count, genres
+
+static const uint32_t kSnapshotSignature = 0x42444154;  // "TADB"
+static const uint32_t kSnapshotVersion = 2;
+
+static const uint32_t kNoColdFields = static_cast<uint32_t>(-1);
+
+// Fixed-size part of an item, where strings are indexes to the string table
+struct SnapshotRecord {
+  int32_t anime_id;
+  uint32_t ids[sync::kLastService + 1];
+  int32_t source;
+  int32_t type;
+  int32_t status;
+  int32_t age_rating;
+  int32_t episode_count;
+  int32_t episode_length;
+  int32_t popularity;
+  double score;
+  uint16_t date_start[3];
+  uint16_t date_end[3];
+  int64_t modified;
+  uint32_t slug;
+  uint32_t title;
+  uint32_t english_title;
+  uint32_t cold_position;
+};
+
+struct SnapshotItem {
+  SnapshotRecord record;
+  std::vector<uint32_t> synonyms;
+  std::vector<uint32_t> genres;
+};
+
+class SnapshotReader {
+public:
+  SnapshotReader(const BYTE* data, size_t size, size_t position = 0);
+
+  bool Read(void* output, size_t length);
+  bool ReadString(std::wstring& str);
+  bool ReadStrings(std::vector<std::wstring>& strings);
+  bool ReadIndexes(std::vector<uint32_t>& indexes, size_t string_count);
+  bool Skip(size_t length);
+  bool SkipString();
+
+  size_t position() const;
+
+  template <typename T>
+  bool Read(T& value) {
+    return Read(&value, sizeof(T));
+  }
+
+private:
+  const BYTE* data_;
+  size_t size_;
+  size_t position_;
+};
+
+class SnapshotWriter {
+public:
+  SnapshotWriter();
+
+  uint32_t AddString(const std::wstring& str);
+  void WriteIndexes(std::string& data, const std::vector<std::wstring>& strings);
+
+  const std::vector<const std::wstring*>& strings() const;
+
+private:
+  std::unordered_map<std::wstring, uint32_t> string_indexes_;
+  std::vector<const std::wstring*> strings_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+SnapshotReader::SnapshotReader(const BYTE* data, size_t size, size_t position)
+    : data_(data), size_(size), position_(position) {
+}
+
+bool SnapshotReader::Read(void* output, size_t length) {
+  if (position_ > size_ || length > size_ - position_)
+    return false;
+
+  memcpy(output, data_ + position_, length);
+  position_ += length;
+  return true;
+}
+
+bool SnapshotReader::ReadString(std::wstring& str) {
+  uint32_t length = 0;
+  if (!Read(length) || length > (size_ - position_) / sizeof(wchar_t))
+    return false;
+
+  str.resize(length);
+  return length == 0 || Read(&str[0], length * sizeof(wchar_t));
+}
+
+bool SnapshotReader::ReadStrings(std::vector<std::wstring>& strings) {
+  uint32_t count = 0;
+  if (!Read(count) || count > (size_ - position_) / sizeof(uint32_t))
+    return false;
+
+  strings.resize(count);
+  for (auto& str : strings)
+    if (!ReadString(str))
+      return false;
+  return true;
+}
+
+bool SnapshotReader::ReadIndexes(std::vector<uint32_t>& indexes,
+                                 size_t string_count) {
+  uint32_t count = 0;
+  if (!Read(count) || count > (size_ - position_) / sizeof(uint32_t))
+    return false;
+
+  indexes.resize(count);
+  if (count > 0 && !Read(&indexes[0], count * sizeof(uint32_t)))
+    return false;
+  for (const auto index : indexes)
+    if (index >= string_count)
+      return false;
+  return true;
+}
+
+bool SnapshotReader::Skip(size_t length) {
+  if (length > size_ - position_)
+    return false;
+
+  position_ += length;
+  return true;
+}
+
+bool SnapshotReader::SkipString() {
+  uint32_t length = 0;
+  if (!Read(length) || length > (size_ - position_) / sizeof(wchar_t))
+    return false;
+
+  return Skip(length * sizeof(wchar_t));
+}
+
+size_t SnapshotReader::position() const {
+  return position_;
+}
+
+// Moves past the cold fields of an item without decoding them
+static bool SkipColdFields(SnapshotReader& reader) {
+  uint32_t producer_count = 0;
+  if (!reader.SkipString() || !reader.Read(producer_count))
+    return false;
+  for (uint32_t i = 0; i < producer_count; ++i)
+    if (!reader.SkipString())
+      return false;
+  return reader.SkipString();
+}
+
+static std::wstring GetSnapshotTempPath() {
+  return taiga::GetPath(taiga::kPathDatabaseAnimeSnapshot) + L".new";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+static void WriteValue(std::string& data, const T& value) {
+  data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void WriteString(std::string& data, const std::wstring& str) {
+  WriteValue(data, static_cast<uint32_t>(str.size()));
+  data.append(reinterpret_cast<const char*>(str.data()),
+              str.size() * sizeof(wchar_t));
+}
+
+static void WriteDate(uint16_t output[3], const Date& date) {
+  output[0] = date.year;
+  output[1] = date.month;
+  output[2] = date.day;
+}
+
+SnapshotWriter::SnapshotWriter() {
+  AddString(EmptyString());
+}
+
+uint32_t SnapshotWriter::AddString(const std::wstring& str) {
+  auto it = string_indexes_.find(str);
+  if (it != string_indexes_.end())
+    return it->second;
+
+  const auto index = static_cast<uint32_t>(strings_.size());
+  it = string_indexes_.insert(std::make_pair(str, index)).first;
+  strings_.push_back(&it->first);
+  return index;
+}
+
+void SnapshotWriter::WriteIndexes(std::string& data,
+                                  const std::vector<std::wstring>& strings) {
+  WriteValue(data, static_cast<uint32_t>(strings.size()));
+  for (const auto& str : strings)
+    WriteValue(data, AddString(str));
+}
+
+const std::vector<const std::wstring*>& SnapshotWriter::strings() const {
+  return strings_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Database::LoadSnapshot() {
+  const auto database_time =
+      GetFileLastWriteTime(taiga::GetPath(taiga::kPathDatabaseAnime));
+  if (!database_time)
+    return false;
+
+  // Replace the snapshot with the one that was written on exit. This fails if
+  // items from an earlier load still refer to it, in which case it is checked
+  // against the database as usual.
+  const auto path = taiga::GetPath(taiga::kPathDatabaseAnimeSnapshot);
+  if (FileExists(GetSnapshotTempPath()))
+    ::MoveFileEx(GetSnapshotTempPath().c_str(), path.c_str(),
+                 MOVEFILE_REPLACE_EXISTING);
+
+  auto file = std::make_shared<MappedFile>();
+  if (!file->Open(path))
+    return false;
+
+  SnapshotReader reader(file->data(), file->size());
+  std::vector<std::wstring> strings;
+  size_t cold_offset = 0;
+  std::vector<SnapshotItem> snapshot_items;
+
+  // Everything is read before any item is touched, so that the XML file can
+  // still be read if the snapshot turns out to be invalid. The cold section is
+  // checked as a whole, so that decoding it later on cannot fail.
+  auto read_items = [&]() {
+    uint32_t signature = 0;
+    uint32_t version = 0;
+    QWORD snapshot_time = 0;
+    if (!reader.Read(signature) || signature != kSnapshotSignature ||
+        !reader.Read(version) || version != kSnapshotVersion ||
+        !reader.Read(snapshot_time) || snapshot_time != database_time ||
+        !reader.ReadStrings(strings) || strings.empty())
+      return false;
+
+    uint32_t cold_size = 0;
+    uint32_t cold_checksum = 0;
+    if (!reader.Read(cold_size) || !reader.Read(cold_checksum))
+      return false;
+    cold_offset = reader.position();
+    if (!reader.Skip(cold_size))
+      return false;
+    uLong checksum = crc32(0L, Z_NULL, 0);
+    checksum = crc32(checksum, file->data() + cold_offset, cold_size);
+    if (checksum != cold_checksum)
+      return false;
+
+    uint32_t item_count = 0;
+    if (!reader.Read(item_count) ||
+        item_count > file->size() / sizeof(SnapshotRecord))
+      return false;
+    snapshot_items.resize(item_count);
+
+    for (auto& snapshot_item : snapshot_items) {
+      auto& record = snapshot_item.record;
+      if (!reader.Read(record) ||
+          !reader.ReadIndexes(snapshot_item.synonyms, strings.size()) ||
+          !reader.ReadIndexes(snapshot_item.genres, strings.size()))
+        return false;
+      for (const auto index : record.ids)
+        if (index >= strings.size())
+          return false;
+      if (record.slug >= strings.size() ||
+          record.title >= strings.size() ||
+          record.english_title >= strings.size())
+        return false;
+      if (record.cold_position != kNoColdFields &&
+          record.cold_position >= cold_size)
+        return false;
+    }
+
+    return true;
+  };
+
+  if (!read_items()) {
+    LOG(LevelWarning, L"Discarding invalid or outdated database snapshot.");
+    return false;
+  }
+
+  auto get_strings = [&strings](const std::vector<uint32_t>& indexes) {
+    std::vector<std::wstring> values;
+    for (const auto index : indexes)
+      values.push_back(strings.at(index));
+    return values;
+  };
+
+  std::shared_ptr<const MappedFile> shared_file = file;
+
+  // Same order as in ReadDatabaseNode
+  for (const auto& snapshot_item : snapshot_items) {
+    const auto& record = snapshot_item.record;
+    Item& item = items[record.anime_id];  // Creates the item if it doesn't exist
+
+    for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++)
+      if (record.ids[i])
+        item.SetId(strings.at(record.ids[i]), i);
+
+    item.SetSource(record.source);
+    item.SetTitle(strings.at(record.title));
+    item.SetType(record.type);
+    item.SetAiringStatus(record.status);
+    item.SetAgeRating(record.age_rating);
+    item.SetGenres(get_strings(snapshot_item.genres));
+    item.SetLastModified(static_cast<time_t>(record.modified));
+
+    item.SetEnglishTitle(strings.at(record.english_title));
+    for (const auto index : snapshot_item.synonyms)
+      item.InsertSynonym(strings.at(index));
+    item.SetPopularity(record.popularity);
+    item.SetScore(record.score);
+    item.SetDateEnd(Date(record.date_end[0], record.date_end[1],
+                         record.date_end[2]));
+    item.SetDateStart(Date(record.date_start[0], record.date_start[1],
+                           record.date_start[2]));
+    item.SetEpisodeLength(record.episode_length);
+    item.SetEpisodeCount(record.episode_count);
+    item.SetSlug(strings.at(record.slug));
+
+    item.cold_fields_ = Item::ColdFields();
+    if (record.cold_position != kNoColdFields) {
+      item.snapshot_file_ = shared_file;
+      item.snapshot_position_ = cold_offset + record.cold_position;
+    } else {
+      item.snapshot_file_.reset();
+    }
+  }
+
+  return true;
+}
+
+bool Database::ReadSnapshotFields(const Item& item, Item::ColdFields& fields) {
+  const auto& file = *item.snapshot_file_;
+  SnapshotReader reader(file.data(), file.size(), item.snapshot_position_);
+
+  // The cold section was checked in LoadSnapshot, so this is not expected to
+  // fail
+  auto read_fields = [&]() {
+    uint32_t producer_count = 0;
+    if (!reader.ReadString(fields.image_url) || !reader.Read(producer_count) ||
+        producer_count > file.size() / sizeof(uint32_t))
+      return false;
+    fields.producers.resize(producer_count);
+    for (auto& producer : fields.producers)
+      if (!reader.ReadString(producer))
+        return false;
+    return reader.ReadString(fields.synopsis);
+  };
+
+  if (!read_fields()) {
+    LOG(LevelError, L"Could not read database snapshot fields of ID: " +
+                    ToWstr(item.GetId()));
+    fields = Item::ColdFields();
+    return false;
+  }
+
+  return true;
+}
+
+const Item::ColdFields& Database::GetColdFields(const Item& item,
+                                                Item::ColdFields& buffer) {
+  if (!item.snapshot_file_)
+    return item.cold_fields_;
+
+  ReadSnapshotFields(item, buffer);
+  return buffer;
+}
+
+bool Database::SaveSnapshot() {
+  const auto database_time =
+      GetFileLastWriteTime(taiga::GetPath(taiga::kPathDatabaseAnime));
+  if (!database_time)
+    return false;
+
+  SnapshotWriter writer;
+  std::string cold_data;
+  std::string item_data;
+
+  for (const auto& it : items) {
+    const Item& item = it.second;
+
+    SnapshotRecord record;
+    memset(&record, 0, sizeof(record));  // padding is written as well
+
+    record.anime_id = it.first;
+    for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++)
+      record.ids[i] = writer.AddString(item.GetId(i));
+    record.source = item.GetSource();
+    record.type = item.GetType();
+    record.status = item.GetAiringStatus();
+    record.age_rating = item.GetAgeRating();
+    // Unknown values are stored as zero, the same as in the XML file
+    record.episode_count = item.GetEpisodeCount() > 0 ?
+        item.GetEpisodeCount() : 0;
+    record.episode_length = item.GetEpisodeLength() > 0 ?
+        item.GetEpisodeLength() : 0;
+    record.popularity = item.GetPopularity();
+    record.score = item.GetScore();
+    WriteDate(record.date_start, item.GetDateStart());
+    WriteDate(record.date_end, item.GetDateEnd());
+    record.modified = item.GetLastModified();
+    record.slug = writer.AddString(item.GetSlug());
+    record.title = writer.AddString(item.GetTitle());
+    record.english_title = writer.AddString(item.GetEnglishTitle());
+
+    if (item.snapshot_file_) {
+      // Copied as they are, without decoding them
+      const auto& file = *item.snapshot_file_;
+      SnapshotReader reader(file.data(), file.size(), item.snapshot_position_);
+      SkipColdFields(reader);
+      record.cold_position = static_cast<uint32_t>(cold_data.size());
+      cold_data.append(
+          reinterpret_cast<const char*>(file.data()) + item.snapshot_position_,
+          reader.position() - item.snapshot_position_);
+    } else {
+      const auto& fields = item.cold_fields_;
+      if (fields.image_url.empty() && fields.producers.empty() &&
+          fields.synopsis.empty()) {
+        record.cold_position = kNoColdFields;
+      } else {
+        record.cold_position = static_cast<uint32_t>(cold_data.size());
+        WriteString(cold_data, fields.image_url);
+        WriteValue(cold_data, static_cast<uint32_t>(fields.producers.size()));
+        for (const auto& producer : fields.producers)
+          WriteString(cold_data, producer);
+        WriteString(cold_data, fields.synopsis);
+      }
+    }
+
+    WriteValue(item_data, record);
+    writer.WriteIndexes(item_data, item.GetSynonyms());
+    writer.WriteIndexes(item_data, item.GetGenres());
+  }
+
+  std::string data;
+  WriteValue(data, kSnapshotSignature);
+  WriteValue(data, kSnapshotVersion);
+  WriteValue(data, database_time);
+  WriteValue(data, static_cast<uint32_t>(writer.strings().size()));
+  for (const auto str : writer.strings())
+    WriteString(data, *str);
+  uLong checksum = crc32(0L, Z_NULL, 0);
+  checksum = crc32(checksum, reinterpret_cast<const Bytef*>(cold_data.data()),
+                   static_cast<uInt>(cold_data.size()));
+  WriteValue(data, static_cast<uint32_t>(cold_data.size()));
+  WriteValue(data, static_cast<uint32_t>(checksum));
+  data.append(cold_data);
+  WriteValue(data, static_cast<uint32_t>(items.size()));
+  data.append(item_data);
+
+  return SaveToFile(data, GetSnapshotTempPath());
+}
+
+}  // namespace anime
\ No newline at end of file
@@ -16,7 +16,10 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include "base/string.h"
+#include "library/anime_db.h"
 #include "library/anime_filter.h"
 #include "library/anime_item.h"
 #include "library/anime_util.h"
@@ -24,6 +27,7 @@
 namespace anime {
 
 Filters::Filters() {
+  text_candidates_.index_version = 0;
   Reset();
 }
 
@@ -52,16 +56,30 @@ bool Filters::CheckItem(const Item& item) const {
 }
 
 bool Filters::FilterText(const Item& item) const {
-  std::vector<std::wstring> words;
-  Split(text, L" ", words);
-  RemoveEmptyStrings(words);
+  UpdateTextCandidates();
 
-  std::vector<std::wstring> titles;
-  GetAllTitles(item.GetId(), titles);
+  const auto& words = text_candidates_.words;
+  if (words.empty())
+    return true;
 
+  std::vector<std::wstring> titles;
   const auto& genres = item.GetGenres();
 
-  for (const auto& word : words) {
+  for (size_t i = 0; i < words.size(); ++i) {
+    const auto& word = words.at(i);
+
+    // Tags that are waiting in the queue are not indexed, so they are the only
+    // place left to look if the item is not a candidate.
+    if (text_candidates_.indexed.at(i)) {
+      const auto& anime_ids = text_candidates_.anime_ids.at(i);
+      if (!std::binary_search(anime_ids.begin(), anime_ids.end(),
+                              item.GetId())) {
+        if (InStr(item.GetMyTags(), word, 0, true) == -1)
+          return false;
+        continue;
+      }
+    }
+
     auto check_strings = [&word](const std::vector<std::wstring>& v) {
       for (const auto& str : v) {
         if (InStr(str, word, 0, true) > -1)
@@ -69,6 +87,8 @@ bool Filters::FilterText(const Item& item) const {
       }
       return false;
     };
+    if (titles.empty())
+      GetAllTitles(item.GetId(), titles);
     if (!check_strings(titles) &&
         !check_strings(genres) &&
         InStr(item.GetMyTags(), word, 0, true) == -1)
@@ -78,6 +98,27 @@ bool Filters::FilterText(const Item& item) const {
   return true;
 }
 
+void Filters::UpdateTextCandidates() const {
+  auto& cache = text_candidates_;
+  auto& text_index = AnimeDatabase.text_index;
+
+  if (cache.text == text && cache.index_version == text_index.version())
+    return;
+
+  cache.text = text;
+  cache.index_version = text_index.version();
+  cache.words.clear();
+  Split(text, L" ", cache.words);
+  RemoveEmptyStrings(cache.words);
+
+  cache.indexed.resize(cache.words.size());
+  cache.anime_ids.resize(cache.words.size());
+  for (size_t i = 0; i < cache.words.size(); ++i) {
+    cache.indexed.at(i) = text_index.Find(cache.words.at(i), kTextIndexAll,
+                                          cache.anime_ids.at(i));
+  }
+}
+
 void Filters::Reset() {
   my_status.clear();
   status.clear();
@@ -41,6 +41,18 @@ public:
 
 private:
   bool FilterText(const Item& item) const;
+  void UpdateTextCandidates() const;
+
+  // Anime that may contain each word of the text filter, as found through the
+  // text index. Words that are too short to be looked up have no candidates.
+  struct TextCandidates {
+    std::wstring text;
+    unsigned int index_version;
+    std::vector<std::wstring> words;
+    std::vector<bool> indexed;
+    std::vector<std::vector<int>> anime_ids;
+  };
+  mutable TextCandidates text_candidates_;
 };
 
 }  // namespace anime
@@ -33,7 +33,8 @@ anime::Database* anime::Item::database_ = &AnimeDatabase;
 
 namespace anime {
 
-Item::Item() {
+Item::Item()
+    : snapshot_position_(0) {
   metadata_.uid.resize(sync::kLastService + 1);
 }
 
@@ -137,10 +138,9 @@ const Date& Item::GetDateEnd() const {
 }
 
 const std::wstring& Item::GetImageUrl() const {
-  if (metadata_.resource.size() > 0)
-    return metadata_.resource.at(0);
+  DecodeSnapshotFields();
 
-  return EmptyString();
+  return cold_fields_.image_url;
 }
 
 enum_t Item::GetAgeRating() const {
@@ -159,7 +159,9 @@ int Item::GetPopularity() const {
 }
 
 const std::vector<std::wstring>& Item::GetProducers() const {
-  return metadata_.creator;
+  DecodeSnapshotFields();
+
+  return cold_fields_.producers;
 }
 
 double Item::GetScore() const {
@@ -170,7 +172,9 @@ double Item::GetScore() const {
 }
 
 const std::wstring& Item::GetSynopsis() const {
-  return metadata_.description;
+  DecodeSnapshotFields();
+
+  return cold_fields_.synopsis;
 }
 
 const time_t Item::GetLastModified() const {
@@ -183,7 +187,14 @@ void Item::SetId(const std::wstring& id, enum_t service) {
   if (metadata_.uid.size() < static_cast<size_t>(service) + 1)
     metadata_.uid.resize(service + 1);
 
+  if (metadata_.uid.at(service) == id)
+    return;
+
+  std::wstring previous_id = metadata_.uid.at(service);
   metadata_.uid.at(service) = id;
+
+  AnimeDatabase.UpdateIdIndex(*this, service, previous_id);
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetSlug(const std::wstring& slug) {
@@ -202,6 +213,7 @@ void Item::SetSource(enum_t source) {
 
 void Item::SetType(int type) {
   metadata_.type = type;
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetEpisodeCount(int number) {
@@ -209,6 +221,7 @@ void Item::SetEpisodeCount(int number) {
     metadata_.extent.resize(1);
 
   metadata_.extent.at(0) = number;
+  AnimeDatabase.columns.Invalidate(GetId());
 
   // TODO: Call it separately
   if (number >= 0)
@@ -224,17 +237,22 @@ void Item::SetEpisodeLength(int number) {
   }
 
   metadata_.extent.at(1) = number;
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetAiringStatus(int status) {
   metadata_.status = status;
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetTitle(const std::wstring& title) {
   metadata_.title = title;
+  AnimeDatabase.text_index.Invalidate(GetId());
 }
 
 void Item::SetEnglishTitle(const std::wstring& title) {
+  AnimeDatabase.text_index.Invalidate(GetId());
+
   foreach_(it, metadata_.alternative) {
     if (it->type == library::kTitleTypeLangEnglish) {
       it->value = title;
@@ -255,6 +273,7 @@ void Item::InsertSynonym(const std::wstring& synonym) {
     return;
   metadata_.alternative.push_back(
       library::Title(library::kTitleTypeSynonym, synonym));
+  AnimeDatabase.text_index.Invalidate(GetId());
 }
 
 void Item::SetSynonyms(const std::wstring& synonyms) {
@@ -275,6 +294,7 @@ void Item::SetSynonyms(const std::vector<std::wstring>& synonyms) {
         return title.type == library::kTitleTypeSynonym;
       });
   metadata_.alternative.erase(iterator, metadata_.alternative.end());
+  AnimeDatabase.text_index.Invalidate(GetId());
 
   for (const auto& synonym : synonyms) {
     InsertSynonym(synonym);
@@ -289,6 +309,7 @@ void Item::SetDateStart(const Date& date) {
   }
 
   metadata_.date.at(0) = date;
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetDateEnd(const Date& date) {
@@ -302,13 +323,9 @@ void Item::SetDateEnd(const Date& date) {
 }
 
 void Item::SetImageUrl(const std::wstring& url) {
-  if (metadata_.resource.size() < 1) {
-    if (url.empty())
-      return;
-    metadata_.resource.resize(1);
-  }
+  DecodeSnapshotFields();
 
-  metadata_.resource.at(0) = url;
+  cold_fields_.image_url = url;
 }
 
 void Item::SetAgeRating(enum_t rating) {
@@ -325,6 +342,7 @@ void Item::SetGenres(const std::wstring& genres) {
 
 void Item::SetGenres(const std::vector<std::wstring>& genres) {
   metadata_.subject = genres;
+  AnimeDatabase.text_index.Invalidate(GetId());
 }
 
 void Item::SetPopularity(int popularity) {
@@ -335,6 +353,7 @@ void Item::SetPopularity(int popularity) {
   }
 
   metadata_.community.at(1) = ToWstr(popularity);
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetProducers(const std::wstring& producers) {
@@ -346,7 +365,9 @@ void Item::SetProducers(const std::wstring& producers) {
 }
 
 void Item::SetProducers(const std::vector<std::wstring>& producers) {
-  metadata_.creator = producers;
+  DecodeSnapshotFields();
+
+  cold_fields_.producers = producers;
 }
 
 void Item::SetScore(double score) {
@@ -357,10 +378,13 @@ void Item::SetScore(double score) {
   }
 
   metadata_.community.at(0) = score > 0.0 ? ToWstr(score) : L"";
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetSynopsis(const std::wstring& synopsis) {
-  metadata_.description = synopsis;
+  DecodeSnapshotFields();
+
+  cold_fields_.synopsis = synopsis;
 }
 
 void Item::SetLastModified(time_t modified) {
@@ -470,30 +494,35 @@ void Item::SetMyLastWatchedEpisode(int number) {
   assert(my_info_.get());
 
   my_info_->watched_episodes = number;
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetMyScore(int score) {
   assert(my_info_.get());
 
   my_info_->score = score;
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetMyStatus(int status) {
   assert(my_info_.get());
 
   my_info_->status = status;
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetMyRewatchedTimes(int rewatched_times) {
   assert(my_info_.get());
 
   my_info_->rewatched_times = rewatched_times;
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetMyRewatching(int rewatching) {
   assert(my_info_.get());
 
   my_info_->rewatching = rewatching;
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 void Item::SetMyRewatchingEp(int rewatching_ep) {
@@ -524,6 +553,7 @@ void Item::SetMyTags(const std::wstring& tags) {
   assert(my_info_.get());
 
   my_info_->tags = tags;
+  AnimeDatabase.text_index.Invalidate(GetId());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -632,6 +662,7 @@ void Item::SetUserSynonyms(const std::wstring& synonyms) {
 void Item::SetUserSynonyms(const std::vector<std::wstring>& synonyms) {
   local_info_.synonyms = synonyms;
   RemoveEmptyStrings(local_info_.synonyms);
+  AnimeDatabase.text_index.Invalidate(GetId());
 
   if (!synonyms.empty() && CurrentEpisode.anime_id == anime::ID_NOTINLIST) {
     CurrentEpisode.Set(anime::ID_UNKNOWN);
@@ -663,6 +694,7 @@ bool Item::UserSynonymsAvailable() const {
 void Item::AddtoUserList() {
   if (!my_info_.get()) {
     my_info_.reset(new MyInformation);
+    AnimeDatabase.columns.Invalidate(GetId());
   }
 }
 
@@ -674,6 +706,8 @@ void Item::RemoveFromUserList() {
   assert(my_info_.use_count() <= 1);
   my_info_.reset();
   assert(my_info_.use_count() == 0);
+  AnimeDatabase.text_index.Invalidate(GetId());
+  AnimeDatabase.columns.Invalidate(GetId());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -682,4 +716,11 @@ HistoryItem* Item::SearchHistory(int search_mode) const {
   return History.queue.FindItem(GetId(), search_mode);
 }
 
+void Item::DecodeSnapshotFields() const {
+  if (snapshot_file_) {
+    Database::ReadSnapshotFields(*this, cold_fields_);
+    snapshot_file_.reset();
+  }
+}
+
 }  // namespace anime
\ No newline at end of file
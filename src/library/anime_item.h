@@ -33,6 +33,7 @@ class Item;
 }
 class Date;
 class HistoryItem;
+class MappedFile;
 
 namespace anime {
 
@@ -161,6 +162,19 @@ private:
   // Local information, stored temporarily
   LocalInformation local_info_;
 
+  // Rarely used fields, which are not a part of metadata_. If the database was
+  // read from a snapshot, they are decoded only when they are first needed.
+  struct ColdFields {
+    std::wstring image_url;
+    std::vector<std::wstring> producers;
+    std::wstring synopsis;
+  };
+  friend class Database;
+  void DecodeSnapshotFields() const;
+  mutable ColdFields cold_fields_;
+  mutable std::shared_ptr<const MappedFile> snapshot_file_;
+  size_t snapshot_position_;
+
   // Pointer to the parent database which holds this item
   static Database* database_;
 };
@@ -0,0 +1,193 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "library/anime_db.h"
+#include "library/anime_item.h"
+#include "library/anime_text_index.h"
+
+namespace anime {
+
+// Same as the case-insensitive comparison in InStr, which only affects ASCII
+// characters.
+static wchar_t FoldChar(wchar_t c) {
+  return (c >= L'A' && c <= L'Z') ? c + (L'a' - L'A') : c;
+}
+
+static void GetFoldedTrigrams(const std::wstring& str, int field,
+                              std::map<trigram_t, int>& trigrams) {
+  for (size_t i = 0; i + 3 <= str.size(); ++i) {
+    auto trigram = PackTrigram(FoldChar(str[i]),
+                               FoldChar(str[i + 1]),
+                               FoldChar(str[i + 2]));
+    trigrams[trigram] |= field;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TextIndex::TextIndex()
+    : invalid_all_(true), version_(0) {
+}
+
+bool TextIndex::Find(const std::wstring& str, int fields,
+                     std::vector<int>& anime_ids) {
+  anime_ids.clear();
+
+  std::map<trigram_t, int> trigrams;
+  GetFoldedTrigrams(str, fields, trigrams);
+  if (trigrams.empty())
+    return false;
+
+  Refresh();
+
+  // Starting with the shortest posting list keeps the intersection small
+  std::vector<const std::vector<Posting>*> lists;
+  for (const auto& trigram : trigrams) {
+    auto it = postings_.find(trigram.first);
+    if (it == postings_.end())
+      return true;
+    lists.push_back(&it->second);
+  }
+  std::sort(lists.begin(), lists.end(),
+      [](const std::vector<Posting>* a, const std::vector<Posting>* b) {
+        return a->size() < b->size();
+      });
+
+  for (const auto& posting : *lists.front())
+    if (posting.fields & fields)
+      anime_ids.push_back(posting.anime_id);
+
+  for (size_t i = 1; i < lists.size() && !anime_ids.empty(); ++i) {
+    const auto& list = *lists.at(i);
+    auto it = list.begin();
+    auto found = anime_ids.begin();
+    for (auto id = anime_ids.begin(); id != anime_ids.end(); ++id) {
+      it = std::lower_bound(it, list.end(), *id, ComparePosting);
+      if (it == list.end())
+        break;
+      if (it->anime_id == *id && (it->fields & fields))
+        *found++ = *id;
+    }
+    anime_ids.erase(found, anime_ids.end());
+  }
+
+  return true;
+}
+
+void TextIndex::Invalidate(int anime_id) {
+  if (!invalid_all_)
+    invalid_ids_.insert(anime_id);
+  version_ += 1;
+}
+
+void TextIndex::InvalidateAll() {
+  invalid_all_ = true;
+  invalid_ids_.clear();
+  version_ += 1;
+}
+
+unsigned int TextIndex::version() const {
+  return version_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool TextIndex::ComparePosting(const Posting& posting, int anime_id) {
+  return posting.anime_id < anime_id;
+}
+
+void TextIndex::Erase(int anime_id) {
+  auto item_trigrams = item_trigrams_.find(anime_id);
+  if (item_trigrams == item_trigrams_.end())
+    return;
+
+  for (const auto& trigram : item_trigrams->second) {
+    auto it = postings_.find(trigram);
+    if (it == postings_.end())
+      continue;
+    auto& list = it->second;
+    auto posting = std::lower_bound(list.begin(), list.end(), anime_id,
+                                    ComparePosting);
+    if (posting != list.end() && posting->anime_id == anime_id)
+      list.erase(posting);
+    if (list.empty())
+      postings_.erase(it);
+  }
+
+  item_trigrams_.erase(item_trigrams);
+}
+
+void TextIndex::Insert(const Item& item) {
+  const int anime_id = item.GetId();
+
+  std::map<trigram_t, int> trigrams;
+
+  GetFoldedTrigrams(item.GetTitle(), kTextIndexTitles, trigrams);
+  GetFoldedTrigrams(item.GetEnglishTitle(), kTextIndexTitles, trigrams);
+  for (const auto& synonym : item.GetSynonyms())
+    GetFoldedTrigrams(synonym, kTextIndexTitles, trigrams);
+  for (const auto& synonym : item.GetUserSynonyms())
+    GetFoldedTrigrams(synonym, kTextIndexTitles, trigrams);
+  for (const auto& genre : item.GetGenres())
+    GetFoldedTrigrams(genre, kTextIndexGenres, trigrams);
+  GetFoldedTrigrams(item.GetMyTags(false), kTextIndexTags, trigrams);
+
+  if (trigrams.empty())
+    return;
+
+  auto& item_trigrams = item_trigrams_[anime_id];
+  item_trigrams.reserve(trigrams.size());
+
+  for (const auto& trigram : trigrams) {
+    auto& list = postings_[trigram.first];
+    Posting new_posting = {anime_id, trigram.second};
+    // Items are usually indexed in ascending order, so we check the end first
+    if (list.empty() || list.back().anime_id < anime_id) {
+      list.push_back(new_posting);
+    } else {
+      auto it = std::lower_bound(list.begin(), list.end(), anime_id,
+                                 ComparePosting);
+      list.insert(it, new_posting);
+    }
+    item_trigrams.push_back(trigram.first);
+  }
+}
+
+void TextIndex::Refresh() {
+  if (invalid_all_) {
+    postings_.clear();
+    item_trigrams_.clear();
+    for (const auto& it : AnimeDatabase.items)
+      Insert(it.second);
+    invalid_all_ = false;
+
+  } else {
+    for (const auto& anime_id : invalid_ids_) {
+      Erase(anime_id);
+      auto anime_item = AnimeDatabase.FindItem(anime_id, false);
+      if (anime_item)
+        Insert(*anime_item);
+    }
+  }
+
+  invalid_ids_.clear();
+}
+
+}  // namespace anime
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_LIBRARY_ANIME_TEXT_INDEX_H
+#define TAIGA_LIBRARY_ANIME_TEXT_INDEX_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/string.h"
+
+namespace anime {
+
+class Item;
+
+enum TextIndexFields {
+  kTextIndexTitles = 1 << 0,
+  kTextIndexGenres = 1 << 1,
+  kTextIndexTags = 1 << 2,
+  kTextIndexAll = kTextIndexTitles | kTextIndexGenres | kTextIndexTags
+};
+
+// Maps the trigrams of every title, genre and tag to the anime they appear in.
+// Lookups return the anime that contain every trigram of a string, which is a
+// superset of the anime that contain the string itself, so callers are
+// expected to verify each candidate. Items that are marked as invalid are
+// indexed again on the next lookup. Matching is case-insensitive for ASCII
+// characters, as is InStr.
+class TextIndex {
+public:
+  TextIndex();
+
+  // Returns false if the string is too short to be looked up, in which case
+  // every anime is a candidate. Otherwise, anime IDs are sorted.
+  bool Find(const std::wstring& str, int fields, std::vector<int>& anime_ids);
+
+  void Invalidate(int anime_id);
+  void InvalidateAll();
+
+  // Changes whenever an item is invalidated, so that callers can tell when
+  // previous lookups are stale.
+  unsigned int version() const;
+
+private:
+  struct Posting {
+    int anime_id;
+    int fields;
+  };
+
+  static bool ComparePosting(const Posting& posting, int anime_id);
+
+  void Erase(int anime_id);
+  void Insert(const Item& item);
+  void Refresh();
+
+  std::map<trigram_t, std::vector<Posting>> postings_;  // sorted by anime ID
+  std::map<int, std::vector<trigram_t>> item_trigrams_;
+  std::set<int> invalid_ids_;
+  bool invalid_all_;
+  unsigned int version_;
+};
+
+}  // namespace anime
+
+#endif  // TAIGA_LIBRARY_ANIME_TEXT_INDEX_H
\ No newline at end of file
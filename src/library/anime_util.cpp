@@ -832,9 +832,13 @@ void GetAllTitles(int anime_id, std::vector<std::wstring>& titles) {
 
 // TODO: We may get rid of this function once MAL fixes their API
 int GetMyRewatchedTimes(const Item& item) {
-  const int rewatched_times = item.GetMyRewatchedTimes();
+  return GetMyRewatchedTimes(item.GetMyRewatchedTimes(),
+                             item.GetMyRewatching() != FALSE);
+}
 
-  if (item.GetMyRewatching()) {
+// Same as above, for values that are not read from an item (e.g. columns)
+int GetMyRewatchedTimes(int rewatched_times, bool rewatching) {
+  if (rewatching) {
     return max(rewatched_times, 1);  // because MAL doesn't tell us the actual value
   } else {
     return rewatched_times;
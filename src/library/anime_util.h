@@ -86,6 +86,7 @@ void IncrementEpisode(int anime_id);
 
 void GetAllTitles(int anime_id, std::vector<std::wstring>& titles);
 int GetMyRewatchedTimes(const Item& item);
+int GetMyRewatchedTimes(int rewatched_times, bool rewatching);
 void GetProgressRatios(const Item& item, float& ratio_aired, float& ratio_watched);
 
 std::wstring TranslateMyStatus(int value, bool add_count);
@@ -43,7 +43,8 @@ HistoryItem::HistoryItem()
 HistoryQueue::HistoryQueue()
     : index(0),
       history(nullptr),
-      updating(false) {
+      updating(false),
+      search_index_outdated_(false) {
 }
 
 void HistoryQueue::Add(HistoryItem& item, bool save) {
@@ -97,6 +98,7 @@ void HistoryQueue::Add(HistoryItem& item, bool save) {
 
   // Edit previous item with the same ID...
   bool add_new_item = true;
+  size_t position = items.size();
   if (!History.queue.updating) {
     foreach_r_(it, items) {
       if (it->anime_id == item.anime_id && it->enabled) {
@@ -124,6 +126,7 @@ void HistoryQueue::Add(HistoryItem& item, bool save) {
           if (!add_new_item) {
             it->mode = taiga::kHttpServiceUpdateLibraryEntry;
             it->time = (std::wstring)GetDate() + L" " + GetTime();
+            position = static_cast<size_t>(items.rend() - it - 1);
           }
           break;
         }
@@ -136,6 +139,12 @@ void HistoryQueue::Add(HistoryItem& item, bool save) {
       item.time = (std::wstring)GetDate() + L" " + GetTime();
     items.push_back(item);
   }
+  // An edited item might precede later items with the same ID (e.g. one that
+  // adds the anime to the list), which take precedence in the index
+  AddToSearchIndex(position);
+
+  // Queued values are returned in place of the stored ones
+  AnimeDatabase.columns.Invalidate(item.anime_id);
 
   if (anime && save) {
     // Save
@@ -205,6 +214,9 @@ void HistoryQueue::Check(bool automatic) {
 void HistoryQueue::Clear(bool save) {
   items.clear();
   index = 0;
+  search_index_.clear();
+  search_index_outdated_ = false;
+  AnimeDatabase.columns.InvalidateAll();
 
   ui::OnHistoryChange();
 
@@ -212,55 +224,64 @@ void HistoryQueue::Clear(bool save) {
     history->Save();
 }
 
+static bool HasSearchValue(const HistoryItem& item, int search_mode) {
+  switch (search_mode) {
+    // Date
+    case kQueueSearchDateStart:
+      return item.date_start;
+    case kQueueSearchDateEnd:
+      return item.date_finish;
+    // Episode
+    case kQueueSearchEpisode:
+      return item.episode;
+    // Rewatched times
+    case kQueueSearchRewatchedTimes:
+      return item.rewatched_times;
+    // Rewatching
+    case kQueueSearchRewatching:
+      return item.enable_rewatching;
+    // Score
+    case kQueueSearchScore:
+      return item.score;
+    // Status
+    case kQueueSearchStatus:
+      return item.status;
+    // Tags
+    case kQueueSearchTags:
+      return item.tags;
+    // Default
+    default:
+      return true;
+  }
+}
+
 HistoryItem* HistoryQueue::FindItem(int anime_id, int search_mode) {
-  for (auto it = items.rbegin(); it != items.rend(); ++it) {
-    if (it->anime_id == anime_id && it->enabled) {
-      switch (search_mode) {
-        // Date
-        case kQueueSearchDateStart:
-          if (it->date_start)
-            return &(*it);
-          break;
-        case kQueueSearchDateEnd:
-          if (it->date_finish)
-            return &(*it);
-          break;
-        // Episode
-        case kQueueSearchEpisode:
-          if (it->episode)
-            return &(*it);
-          break;
-        // Rewatched times
-        case kQueueSearchRewatchedTimes:
-          if (it->rewatched_times)
-            return &(*it);
-          break;
-        // Rewatching
-        case kQueueSearchRewatching:
-          if (it->enable_rewatching)
-            return &(*it);
-          break;
-        // Score
-        case kQueueSearchScore:
-          if (it->score)
-            return &(*it);
-          break;
-        // Status
-        case kQueueSearchStatus:
-          if (it->status)
-            return &(*it);
-          break;
-        // Tags
-        case kQueueSearchTags:
-          if (it->tags)
-            return &(*it);
-          break;
-        // Default
-        default:
-          return &(*it);
-      }
+  if (search_mode < 0 || search_mode >= kQueueSearchLast)
+    search_mode = 0;
+
+  if (search_index_outdated_)
+    RebuildSearchIndex();
+
+  for (int pass = 0; pass < 2; ++pass) {
+    auto it = search_index_.find(anime_id);
+    if (it == search_index_.end())
+      return nullptr;
+
+    const int position = it->second.at(search_mode);
+    if (position < 0)
+      return nullptr;
+
+    // Items may have been changed without going through the queue
+    if (position < static_cast<int>(items.size())) {
+      HistoryItem& item = items.at(position);
+      if (item.anime_id == anime_id && item.enabled &&
+          HasSearchValue(item, search_mode))
+        return &item;
     }
+
+    RebuildSearchIndex();
   }
+
   return nullptr;
 }
 
@@ -271,6 +292,10 @@ HistoryItem* HistoryQueue::GetCurrentItem() {
   return nullptr;
 }
 
+void HistoryQueue::InvalidateSearchIndex() {
+  search_index_outdated_ = true;
+}
+
 int HistoryQueue::GetItemCount() {
   int count = 0;
 
@@ -307,6 +332,8 @@ void HistoryQueue::Remove(int index, bool save, bool refresh, bool to_history) {
     }
 
     items.erase(it);
+    search_index_outdated_ = true;
+    AnimeDatabase.columns.Invalidate(history_item.anime_id);
 
     if (refresh)
       ui::OnHistoryChange(&history_item);
@@ -316,12 +343,39 @@ void HistoryQueue::Remove(int index, bool save, bool refresh, bool to_history) {
     history->Save();
 }
 
+void HistoryQueue::AddToSearchIndex(size_t position) {
+  const HistoryItem& item = items.at(position);
+  if (!item.enabled)
+    return;
+
+  auto& positions = search_index_[item.anime_id];
+  if (positions.empty())
+    positions.resize(kQueueSearchLast, -1);
+
+  for (int search_mode = 0; search_mode < kQueueSearchLast; ++search_mode) {
+    auto& latest_position = positions.at(search_mode);
+    if (HasSearchValue(item, search_mode) &&
+        latest_position < static_cast<int>(position))
+      latest_position = static_cast<int>(position);
+  }
+}
+
+void HistoryQueue::RebuildSearchIndex() {
+  search_index_.clear();
+  search_index_outdated_ = false;
+
+  for (size_t i = 0; i < items.size(); ++i)
+    AddToSearchIndex(i);
+}
+
 void HistoryQueue::RemoveDisabled(bool save, bool refresh) {
   bool needs_refresh = false;
 
   for (size_t i = 0; i < items.size(); i++) {
     if (!items.at(i).enabled) {
+      AnimeDatabase.columns.Invalidate(items.at(i).anime_id);
       items.erase(items.begin() + i);
+      search_index_outdated_ = true;
       needs_refresh = true;
       i--;
     }
@@ -353,6 +407,7 @@ void History::Clear(bool save) {
 bool History::Load() {
   items.clear();
   queue.items.clear();
+  queue.InvalidateSearchIndex();
 
   xml_document document;
   std::wstring path = taiga::GetPath(taiga::kPathUserHistory);
@@ -388,6 +443,7 @@ bool History::Load() {
   } else {
     ReadQueue(document);
   }
+  AnimeDatabase.columns.InvalidateAll();
 
   return true;
 }
@@ -21,6 +21,7 @@
 
 #include <string>
 #include <queue>
+#include <unordered_map>
 #include <vector>
 
 #include "base/optional.h"
@@ -36,7 +37,8 @@ enum QueueSearchMode {
   kQueueSearchRewatching,
   kQueueSearchScore,
   kQueueSearchStatus,
-  kQueueSearchTags
+  kQueueSearchTags,
+  kQueueSearchLast
 };
 
 class AnimeValues {
@@ -76,6 +78,7 @@ public:
   HistoryItem* FindItem(int anime_id, int search_mode = 0);
   HistoryItem* GetCurrentItem();
   int GetItemCount();
+  void InvalidateSearchIndex();
   void Remove(int index = -1, bool save = true, bool refresh = true, bool to_history = true);
   void RemoveDisabled(bool save = true, bool refresh = true);
 
@@ -83,6 +86,14 @@ public:
   std::vector<HistoryItem> items;
   History* history;
   bool updating;
+
+private:
+  void AddToSearchIndex(size_t position);
+  void RebuildSearchIndex();
+
+  // Position of the latest enabled item of each anime, for each search mode
+  std::unordered_map<int, std::vector<int>> search_index_;
+  bool search_index_outdated_;
 };
 
 class History {
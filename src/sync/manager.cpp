@@ -27,6 +27,7 @@
 #include "taiga/http.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
+#include "track/recognition.h"
 #include "ui/ui.h"
 
 sync::Manager ServiceManager;
@@ -181,7 +182,14 @@ void Manager::HandleError(Response& response, HttpResponse& http_response) {
 void Manager::HandleResponse(Response& response, HttpResponse& http_response) {
   // Let the service do its thing
   Service& service = *services_[response.service_id].get();
+  // Downloading the list updates every item, so the recognition engine is
+  // told to refresh its indexes once afterwards, rather than after each item.
+  const bool bulk_update = response.type == kGetLibraryEntries;
+  if (bulk_update)
+    Meow.BeginTitleUpdate();
   service.HandleResponse(response, http_response);
+  if (bulk_update)
+    Meow.CommitTitleUpdate();
 
   // Check for error
   if (response.data.count(L"error")) {
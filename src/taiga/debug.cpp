@@ -16,9 +16,19 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <functional>
+#include <crtdbg.h>
+
+#include "base/log.h"
+#include "base/metrics.h"
 #include "base/string.h"
+#include "base/xml.h"
 #include "library/anime_db.h"
+#include "library/anime_episode.h"
 #include "taiga/debug.h"
+#include "taiga/path.h"
+#include "track/recognition.h"
 #include "ui/dlg/dlg_main.h"
 #include "ui/dialog.h"
 
@@ -83,4 +93,143 @@ void Test() {
   test.End(str, true);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _DEBUG
+static long allocation_count = 0;
+
+static int CountAllocations(int type, void*, size_t, int, long,
+                            const unsigned char*, int) {
+  if (type == _HOOK_ALLOC || type == _HOOK_REALLOC)
+    InterlockedIncrement(&allocation_count);
+  return TRUE;
+}
+#endif
+
+// Replays the filenames in the recognition test file through the parser and
+// the identification stage, and logs latency percentiles, allocations and
+// accuracy. The file is in the following format:
+//
+//   <tests>
+//     <test id="1234" type="file">[Group] Title - 01 [720p].mkv</test>
+//     <test id="5678" type="feed">[Group] Title 02 (1280x720)</test>
+//   </tests>
+//
+// "type" is one of "file", "feed" or "stream", and determines the options that
+// are used. Tests without an "id" attribute are only timed. IDs refer to
+// MyAnimeList, and the anime must be in the local database to be recognized.
+// A sample is in data\test\recognition.xml, which is not installed.
+void TestRecognition() {
+  xml_document document;
+  std::wstring path = taiga::GetPath(taiga::kPathTestRecognition);
+  xml_parse_result parse_result = document.load_file(path.c_str());
+
+  if (parse_result.status != pugi::status_ok) {
+    ui::DlgMain.SetText(L"Could not read recognition tests: " + path);
+    return;
+  }
+
+  // Titles are initialized beforehand, so that they don't skew the results
+  Meow.InitializeTitles();
+  base::ResetMetrics();
+
+  struct Stage {
+    Stage() : allocations(0) {}
+    std::vector<double> durations;
+    long allocations;
+  } parse_stage, identify_stage;
+
+  size_t labeled = 0, correct = 0;
+  LARGE_INTEGER frequency, start, end;
+  ::QueryPerformanceFrequency(&frequency);
+
+#ifdef _DEBUG
+  auto previous_hook = _CrtSetAllocHook(CountAllocations);
+#endif
+
+  auto measure = [&](Stage& stage, std::function<void()> function) {
+#ifdef _DEBUG
+    const long allocations = allocation_count;
+#endif
+    ::QueryPerformanceCounter(&start);
+    function();
+    ::QueryPerformanceCounter(&end);
+    stage.durations.push_back(
+        static_cast<double>(end.QuadPart - start.QuadPart) * 1000.0 /
+        frequency.QuadPart);
+#ifdef _DEBUG
+    stage.allocations += allocation_count - allocations;
+#endif
+  };
+
+  foreach_xmlnode_(node, document.child(L"tests"), L"test") {
+    const std::wstring filename = node.child_value();
+    const std::wstring type = node.attribute(L"type").as_string(L"file");
+
+    track::recognition::ParseOptions parse_options;
+    parse_options.parse_path = type == L"file";
+    parse_options.streaming_media = type == L"stream";
+    track::recognition::MatchOptions match_options;
+    match_options.allow_sequels = true;
+    match_options.check_airing_date = true;
+    match_options.check_anime_type = true;
+    match_options.check_episode_number = true;
+
+    anime::Episode episode;
+    bool parsed = false;
+    measure(parse_stage, [&]() {
+      parsed = Meow.Parse(filename, parse_options, episode);
+    });
+    if (parsed) {
+      measure(identify_stage, [&]() {
+        Meow.Identify(episode, false, match_options);
+      });
+    }
+
+    if (!node.attribute(L"id").empty()) {
+      ++labeled;
+      if (episode.anime_id == node.attribute(L"id").as_int())
+        ++correct;
+      else
+        LOG(LevelDebug, L"Misidentified: " + filename + L" -> " +
+                        ToWstr(episode.anime_id));
+    }
+  }
+
+#ifdef _DEBUG
+  _CrtSetAllocHook(previous_hook);
+#endif
+
+  auto summarize = [](const std::wstring& name, Stage& stage) {
+    auto& durations = stage.durations;
+    if (durations.empty())
+      return name + L": -";
+    std::sort(durations.begin(), durations.end());
+    auto percentile = [&durations](size_t n) {
+      return ToWstr(durations.at((durations.size() - 1) * n / 100), 3);
+    };
+    std::wstring text = name + L": p50 " + percentile(50) +
+                        L"ms, p90 " + percentile(90) +
+                        L"ms, p99 " + percentile(99) +
+                        L"ms, max " + ToWstr(durations.back(), 3) + L"ms";
+#ifdef _DEBUG
+    text += L", " + ToWstr(static_cast<double>(stage.allocations) /
+                           durations.size(), 1) + L" allocations per call";
+#endif
+    return text;
+  };
+
+  const std::wstring accuracy = L"Accuracy: " + ToWstr(correct) + L"/" +
+                                ToWstr(labeled);
+  const std::wstring parse_summary = summarize(L"Parse", parse_stage);
+  const std::wstring identify_summary = summarize(L"Identify", identify_stage);
+
+  LOG(LevelDebug, parse_summary);
+  LOG(LevelDebug, identify_summary);
+  LOG(LevelDebug, accuracy);
+  base::LogMetrics();
+
+  ui::DlgMain.SetText(accuracy + L" | " + identify_summary);
+}
+
 } // namespace debug
\ No newline at end of file
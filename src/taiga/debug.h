@@ -37,6 +37,7 @@ class Tester {
 
 void Print(std::wstring text);
 void Test();
+void TestRecognition();
 
 }  // namespace debug
 
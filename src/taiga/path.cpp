@@ -58,6 +58,10 @@ std::wstring GetPath(PathType type) {
       return data_path + L"db\\anime.xml";
     case kPathDatabaseAnimeRelations:
       return data_path + L"db\\anime_relations.txt";
+    case kPathDatabaseAnimeSnapshot:
+      return data_path + L"db\\anime.bin";
+    case kPathDatabaseAnimeTitles:
+      return data_path + L"db\\anime_titles.bin";
     case kPathDatabaseImage:
       return data_path + L"db\\image\\";
     case kPathDatabaseSeason:
@@ -84,6 +88,8 @@ std::wstring GetPath(PathType type) {
       return data_path + L"user\\" + GetUserDirectoryName() + L"\\history.xml";
     case kPathUserLibrary:
       return data_path + L"user\\" + GetUserDirectoryName() + L"\\anime.xml";
+    case kPathUserLibraryJournal:
+      return data_path + L"user\\" + GetUserDirectoryName() + L"\\anime.journal";
   }
 }
 
@@ -28,6 +28,8 @@ enum PathType {
   kPathDatabase,
   kPathDatabaseAnime,
   kPathDatabaseAnimeRelations,
+  kPathDatabaseAnimeSnapshot,
+  kPathDatabaseAnimeTitles,
   kPathDatabaseImage,
   kPathDatabaseSeason,
   kPathFeed,
@@ -40,7 +42,8 @@ enum PathType {
   kPathThemeCurrent,
   kPathUser,
   kPathUserHistory,
-  kPathUserLibrary
+  kPathUserLibrary,
+  kPathUserLibraryJournal
 };
 
 std::wstring GetPath(PathType type);
@@ -55,42 +55,47 @@ void Statistics::CalculateAll() {
 }
 
 int Statistics::CalculateAnimeCount() {
+  const auto& columns = AnimeDatabase.columns.Get();
   anime_count = 0;
 
-  foreach_(it, AnimeDatabase.items)
-    if (it->second.IsInList())
+  for (size_t row = 0; row < columns.anime_ids.size(); ++row)
+    if (columns.in_list[row])
       anime_count++;
 
   return anime_count;
 }
 
 int Statistics::CalculateEpisodeCount() {
+  const auto& columns = AnimeDatabase.columns.Get();
   episode_count = 0;
 
-  foreach_(it, AnimeDatabase.items) {
-    if (!it->second.IsInList())
+  for (size_t row = 0; row < columns.anime_ids.size(); ++row) {
+    if (!columns.in_list[row])
       continue;
 
-    episode_count += it->second.GetMyLastWatchedEpisode();
-    episode_count += anime::GetMyRewatchedTimes(it->second) *
-                     it->second.GetEpisodeCount();
+    const int rewatched_times = anime::GetMyRewatchedTimes(
+        columns.my_rewatched_times[row], columns.my_rewatching[row] != 0);
+
+    episode_count += columns.my_last_watched_episodes[row];
+    episode_count += rewatched_times * columns.episode_counts[row];
   }
 
   return episode_count;
 }
 
 const std::wstring& Statistics::CalculateLifeSpentWatching() {
+  const auto& columns = AnimeDatabase.columns.Get();
   int duration = 0;
   int seconds = 0;
 
-  foreach_(it, AnimeDatabase.items) {
-    if (!it->second.IsInList())
+  for (size_t row = 0; row < columns.anime_ids.size(); ++row) {
+    if (!columns.in_list[row])
       continue;
 
-    duration = it->second.GetEpisodeLength();
+    duration = columns.episode_lengths[row];
     if (duration <= 0) {
       // Approximate duration in minutes
-      switch (it->second.GetType()) {
+      switch (columns.types[row]) {
         default:
         case anime::kTv:      duration = 24; break;
         case anime::kOva:     duration = 24; break;
@@ -101,9 +106,11 @@ const std::wstring& Statistics::CalculateLifeSpentWatching() {
       }
     }
 
-    int episodes_watched = it->second.GetMyLastWatchedEpisode();
-    episodes_watched += anime::GetMyRewatchedTimes(it->second) *
-                        it->second.GetEpisodeCount();
+    const int rewatched_times = anime::GetMyRewatchedTimes(
+        columns.my_rewatched_times[row], columns.my_rewatching[row] != 0);
+
+    int episodes_watched = columns.my_last_watched_episodes[row];
+    episodes_watched += rewatched_times * columns.episode_counts[row];
 
     seconds += (duration * 60) * episodes_watched;
   }
@@ -134,12 +141,13 @@ float Statistics::CalculateMeanScore() {
   float items_scored = 0.0f;
   float sum_scores = 0.0f;
 
-  foreach_(it, AnimeDatabase.items) {
-    if (!it->second.IsInList())
+  const auto& columns = AnimeDatabase.columns.Get();
+  for (size_t row = 0; row < columns.anime_ids.size(); ++row) {
+    if (!columns.in_list[row])
       continue;
 
-    if (it->second.GetMyScore() > 0) {
-      sum_scores += static_cast<float>(it->second.GetMyScore());
+    if (columns.my_scores[row] > 0) {
+      sum_scores += static_cast<float>(columns.my_scores[row]);
       items_scored++;
     }
   }
@@ -153,12 +161,13 @@ float Statistics::CalculateScoreDeviation() {
   float items_scored = 0.0f;
   float sum_squares = 0.0f;
 
-  foreach_(it, AnimeDatabase.items) {
-    if (!it->second.IsInList())
+  const auto& columns = AnimeDatabase.columns.Get();
+  for (size_t row = 0; row < columns.anime_ids.size(); ++row) {
+    if (!columns.in_list[row])
       continue;
 
-    if (it->second.GetMyScore() > 0) {
-      float score = static_cast<float>(it->second.GetMyScore());
+    if (columns.my_scores[row] > 0) {
+      float score = static_cast<float>(columns.my_scores[row]);
       sum_squares += pow(score - score_mean, 2);
       items_scored++;
     }
@@ -177,8 +186,9 @@ const std::vector<float>& Statistics::CalculateScoreDistribution() {
 
   float extreme_value = 1.0f;
 
-  foreach_(it, AnimeDatabase.items) {
-    int score = it->second.GetMyScore();
+  const auto& columns = AnimeDatabase.columns.Get();
+  for (size_t row = 0; row < columns.anime_ids.size(); ++row) {
+    int score = columns.my_scores[row];
     if (score > 0) {
       score_count[score]++;
       score_distribution[score]++;
@@ -30,6 +30,7 @@
 #include "taiga/taiga.h"
 #include "taiga/version.h"
 #include "track/media.h"
+#include "track/recognition.h"
 #include "ui/dialog.h"
 #include "ui/menu.h"
 #include "ui/theme.h"
@@ -121,7 +122,10 @@ void App::Uninitialize() {
 
   // Save
   Settings.Save();
-  AnimeDatabase.SaveDatabase();
+  if (AnimeDatabase.SaveDatabase())
+    AnimeDatabase.SaveSnapshot();
+  AnimeDatabase.CompactListJournal();
+  Meow.SaveTitleIndex();
   Aggregator.SaveArchive();
 
   // Exit
@@ -82,20 +82,26 @@ bool Aggregator::CheckFeed(FeedCategory category, const std::wstring& source,
 }
 
 void Aggregator::ExamineData(Feed& feed) {
-  for (auto& feed_item : feed.items) {
-    auto& episode_data = feed_item.episode_data;
-
-    // Examine title and compare with anime list items
-    static track::recognition::ParseOptions parse_options;
-    parse_options.parse_path = false;
-    parse_options.streaming_media = false;
-    Meow.Parse(feed_item.title, parse_options, episode_data);
-    static track::recognition::MatchOptions match_options;
-    match_options.allow_sequels = true;
-    match_options.check_airing_date = true;
-    match_options.check_anime_type = true;
-    match_options.check_episode_number = true;
-    Meow.Identify(episode_data, false, match_options);
+  // Examine titles and compare with anime list items
+  static track::recognition::ParseOptions parse_options;
+  parse_options.parse_path = false;
+  parse_options.streaming_media = false;
+  static track::recognition::MatchOptions match_options;
+  match_options.allow_sequels = true;
+  match_options.check_airing_date = true;
+  match_options.check_anime_type = true;
+  match_options.check_episode_number = true;
+
+  std::vector<std::wstring> titles;
+  for (const auto& feed_item : feed.items)
+    titles.push_back(feed_item.title);
+
+  std::vector<anime::Episode> episodes;
+  Meow.RecognizeBatch(titles, parse_options, match_options, episodes);
+
+  for (size_t i = 0; i < feed.items.size(); ++i) {
+    auto& episode_data = feed.items.at(i).episode_data;
+    static_cast<anime::Episode&>(episode_data) = episodes.at(i);
 
     // Update last aired episode number
     if (anime::IsValidId(episode_data.anime_id)) {
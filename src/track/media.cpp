@@ -355,18 +355,19 @@ void ProcessMediaPlayerTitle(const MediaPlayer& media_player) {
     static track::recognition::ParseOptions parse_options;
     parse_options.parse_path = true;
     parse_options.streaming_media = media_player.mode == kMediaModeWebBrowser;
-    if (Meow.Parse(MediaPlayers.current_title(), parse_options, CurrentEpisode)) {
+    static track::recognition::MatchOptions match_options;
+    match_options.allow_sequels = true;
+    match_options.check_airing_date = true;
+    match_options.check_anime_type = true;
+    match_options.check_episode_number = true;
+    if (Meow.Recognize(MediaPlayers.current_title(), parse_options,
+                       match_options, CurrentEpisode, true)) {
       bool is_inside_library_folders = true;
       if (Settings.GetBool(taiga::kSync_Update_OutOfRoot))
         if (!CurrentEpisode.folder.empty() && !Settings.library_folders.empty())
           is_inside_library_folders = anime::IsInsideLibraryFolders(CurrentEpisode.folder);
       if (is_inside_library_folders) {
-        static track::recognition::MatchOptions match_options;
-        match_options.allow_sequels = true;
-        match_options.check_airing_date = true;
-        match_options.check_anime_type = true;
-        match_options.check_episode_number = true;
-        auto anime_id = Meow.Identify(CurrentEpisode, true, match_options);
+        auto anime_id = CurrentEpisode.anime_id;
         if (anime::IsValidId(anime_id)) {
           // Recognized
           anime_item = AnimeDatabase.FindItem(anime_id);
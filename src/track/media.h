@@ -82,7 +82,7 @@ public:
   std::wstring GetTitleFromSpecialMessage(HWND hwnd);
   std::wstring GetTitleFromMPlayer();
   std::wstring GetTitleFromBrowser(HWND hwnd, const MediaPlayer& media_player);
-  std::wstring GetTitleFromStreamingMediaProvider(const std::wstring& url, std::wstring& title);
+  std::wstring GetTitleFromStreamingMediaProvider(HWND hwnd, const std::wstring& url, std::wstring& title);
 
 public:
   std::vector<MediaPlayer> items;
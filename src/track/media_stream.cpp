@@ -246,7 +246,7 @@ std::wstring MediaPlayers::FromActiveAccessibility(HWND hwnd, int web_engine,
         break;
     }
     if (child) {
-      title = GetTitleFromStreamingMediaProvider(child->value, title);
+      title = GetTitleFromStreamingMediaProvider(hwnd, child->value, title);
     } else {
       title.clear();
     }
@@ -308,7 +308,7 @@ std::wstring MediaPlayers::FromAutomationApi(HWND hwnd, int web_engine,
         element_browser, UIA_EditControlTypeId, false);
     if (element_url) {
       title = GetTitleFromStreamingMediaProvider(
-          ui_automation.GetElementValue(element_url), title);
+          hwnd, ui_automation.GetElementValue(element_url), title);
       element_url->Release();
     } else {
       title.clear();
@@ -388,35 +388,195 @@ bool IsStreamSettingEnabled(StreamingVideoProvider stream_provider) {
   return false;
 }
 
-bool MatchStreamUrl(StreamingVideoProvider stream_provider,
-                    const std::wstring& url) {
+// URLs are matched by hand rather than with regular expressions, which would
+// otherwise be compiled for each provider on every check.
+
+static bool IsDigit(wchar_t c) {
+  return c >= L'0' && c <= L'9';
+}
+
+// Returns true if the host is the domain itself, or one of its subdomains.
+static bool IsHostOf(const std::wstring& host, const std::wstring& domain) {
+  if (!EndsWith(host, domain))
+    return false;
+  const size_t pos = host.size() - domain.size();
+  return pos == 0 || host.at(pos - 1) == L'.';
+}
+
+// Returns the length of the path segment that begins at the position, or npos
+// if it is not followed by a slash.
+static size_t GetSegmentLength(const std::wstring& path, size_t pos) {
+  const size_t end = path.find(L'/', pos);
+  return end == path.npos ? path.npos : end - pos;
+}
+
+static bool IsIpv4Address(const std::wstring& str) {
+  size_t pos = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (i > 0) {
+      if (pos >= str.size() || str.at(pos) != L'.')
+        return false;
+      ++pos;
+    }
+    size_t digits = 0;
+    while (pos < str.size() && IsDigit(str.at(pos)) && digits < 3) {
+      ++pos;
+      ++digits;
+    }
+    if (!digits)
+      return false;
+  }
+  return pos == str.size();
+}
+
+static void SplitStreamUrl(const std::wstring& url,
+                           std::wstring& host, std::wstring& path) {
+  size_t pos = url.find(L"://");
+  pos = pos == url.npos ? 0 : pos + 3;
+
+  const size_t host_end = url.find_first_of(L"/?#", pos);
+  if (host_end == url.npos) {
+    host = url.substr(pos);
+    path.clear();
+  } else {
+    host = url.substr(pos, host_end - pos);
+    path = url.substr(host_end);
+  }
+}
+
+static bool MatchStreamHost(StreamingVideoProvider stream_provider,
+                            const std::wstring& host) {
   switch (stream_provider) {
     case kStreamAnimelab:
-      return InStr(url, L"animelab.com/player/") > -1;
+      return IsHostOf(host, L"animelab.com");
     case kStreamAnn:
-      return SearchRegex(url, L"animenewsnetwork.com/video/[0-9]+");
-    case kStreamCrunchyroll:
-      return SearchRegex(url, L"crunchyroll\\.[a-z.]+/[^/]+/episode-[0-9]+.*-[0-9]+") ||
-             SearchRegex(url, L"crunchyroll\\.[a-z.]+/[^/]+/.*-movie-[0-9]+");
+      return IsHostOf(host, L"animenewsnetwork.com");
+    case kStreamCrunchyroll: {
+      // crunchyroll.com, crunchyroll.co.jp, etc.
+      size_t pos = host.find(L"crunchyroll.");
+      if (pos == host.npos || (pos > 0 && host.at(pos - 1) != L'.'))
+        return false;
+      pos += 12;
+      if (pos == host.size())
+        return false;
+      for (; pos < host.size(); ++pos) {
+        const wchar_t c = host.at(pos);
+        if ((c < L'a' || c > L'z') && c != L'.')
+          return false;
+      }
+      return true;
+    }
     case kStreamDaisuki:
-      return InStr(url, L"daisuki.net/anime/watch/") > -1;
-    case kStreamPlex:
-      return SearchRegex(url,
-          L"(?:(?:localhost|\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}):32400|plex.tv)/web/");
+      return IsHostOf(host, L"daisuki.net");
+    case kStreamPlex: {
+      if (IsHostOf(host, L"plex.tv"))
+        return true;
+      if (!EndsWith(host, L":32400"))
+        return false;
+      const std::wstring address = host.substr(0, host.size() - 6);
+      return address == L"localhost" || IsIpv4Address(address);
+    }
     case kStreamVeoh:
-      return InStr(url, L"veoh.com/watch/") > -1;
+      return IsHostOf(host, L"veoh.com");
     case kStreamViz:
-      return SearchRegex(url, L"viz.com/anime/streaming/[^/]+-episode-[0-9]+/") ||
-             SearchRegex(url, L"viz.com/anime/streaming/[^/]+-movie/");
+      return IsHostOf(host, L"viz.com");
     case kStreamWakanim:
-      return SearchRegex(url, L"wakanim\\.tv/video(-premium)?/[^/]+/");
+      return IsHostOf(host, L"wakanim.tv");
+    case kStreamYoutube:
+      return IsHostOf(host, L"youtube.com");
+  }
+
+  return false;
+}
+
+static bool MatchStreamPath(StreamingVideoProvider stream_provider,
+                            const std::wstring& path) {
+  switch (stream_provider) {
+    case kStreamAnimelab:
+      return StartsWith(path, L"/player/");
+    case kStreamAnn:
+      // /video/[0-9]+
+      return StartsWith(path, L"/video/") &&
+             path.size() > 7 && IsDigit(path.at(7));
+    case kStreamCrunchyroll: {
+      if (path.empty() || path.at(0) != L'/')
+        return false;
+      const size_t length = GetSegmentLength(path, 1);
+      if (length == 0 || length == path.npos)
+        return false;
+      const size_t pos = length + 2;
+      // /[^/]+/episode-[0-9]+.*-[0-9]+
+      if (path.compare(pos, 8, L"episode-") == 0 &&
+          pos + 8 < path.size() && IsDigit(path.at(pos + 8))) {
+        for (size_t i = pos + 9; i + 1 < path.size(); ++i)
+          if (path.at(i) == L'-' && IsDigit(path.at(i + 1)))
+            return true;
+      }
+      // /[^/]+/.*-movie-[0-9]+
+      for (size_t i = path.find(L"-movie-", pos); i != path.npos;
+           i = path.find(L"-movie-", i + 1)) {
+        if (i + 7 < path.size() && IsDigit(path.at(i + 7)))
+          return true;
+      }
+      return false;
+    }
+    case kStreamDaisuki:
+      return StartsWith(path, L"/anime/watch/");
+    case kStreamPlex:
+      return StartsWith(path, L"/web/");
+    case kStreamVeoh:
+      return StartsWith(path, L"/watch/");
+    case kStreamViz: {
+      if (!StartsWith(path, L"/anime/streaming/"))
+        return false;
+      const size_t length = GetSegmentLength(path, 17);
+      if (length == path.npos)
+        return false;
+      const std::wstring segment = path.substr(17, length);
+      // [^/]+-movie/
+      if (segment.size() > 6 && EndsWith(segment, L"-movie"))
+        return true;
+      // [^/]+-episode-[0-9]+/
+      size_t pos = segment.size();
+      while (pos > 0 && IsDigit(segment.at(pos - 1)))
+        --pos;
+      return pos < segment.size() && pos > 9 &&
+             segment.compare(pos - 9, 9, L"-episode-") == 0;
+    }
+    case kStreamWakanim: {
+      // /video(-premium)?/[^/]+/
+      size_t pos = 0;
+      if (StartsWith(path, L"/video/")) {
+        pos = 7;
+      } else if (StartsWith(path, L"/video-premium/")) {
+        pos = 15;
+      } else {
+        return false;
+      }
+      const size_t length = GetSegmentLength(path, pos);
+      return length != 0 && length != path.npos;
+    }
     case kStreamYoutube:
-      return InStr(url, L"youtube.com/watch") > -1;
+      return StartsWith(path, L"/watch");
   }
 
   return false;
 }
 
+// Each host belongs to a single provider, so the first match is the only one.
+static StreamingVideoProvider FindStreamProvider(const std::wstring& url) {
+  std::wstring host, path;
+  SplitStreamUrl(url, host, path);
+
+  for (int i = kStreamFirst; i < kStreamLast; i++) {
+    auto stream = static_cast<StreamingVideoProvider>(i);
+    if (MatchStreamHost(stream, host))
+      return MatchStreamPath(stream, path) ? stream : kStreamUnknown;
+  }
+
+  return kStreamUnknown;
+}
+
 void CleanStreamTitle(StreamingVideoProvider stream_provider,
                       std::wstring& title) {
   switch (stream_provider) {
@@ -482,27 +642,64 @@ void CleanStreamTitle(StreamingVideoProvider stream_provider,
   }
 }
 
+// Browsers are polled repeatedly while the same page is open, so we keep the
+// result of the last check around.
+class StreamCache {
+public:
+  StreamCache()
+      : window(nullptr),
+        stream_provider(kStreamUnknown),
+        title_provider(kStreamUnknown),
+        title_valid(false) {
+  }
+
+  HWND window;
+  std::wstring url;
+  StreamingVideoProvider stream_provider;
+
+  std::wstring title;
+  std::wstring clean_title;
+  StreamingVideoProvider title_provider;
+  bool title_valid;
+};
+
+static StreamCache stream_cache;
+
 std::wstring MediaPlayers::GetTitleFromStreamingMediaProvider(
+    HWND hwnd,
     const std::wstring& url,
     std::wstring& title) {
-  StreamingVideoProvider stream_provider = kStreamUnknown;
+  auto& cache = stream_cache;
 
   // Check URL for known streaming video providers
-  if (!url.empty()) {
-    for (int i = kStreamFirst; i < kStreamLast; i++) {
-      auto stream = static_cast<StreamingVideoProvider>(i);
-      if (IsStreamSettingEnabled(stream)) {
-        if (MatchStreamUrl(stream, url)) {
-          stream_provider = stream;
-          break;
-        }
-      }
-    }
+  if (hwnd != cache.window || url != cache.url) {
+    cache.window = hwnd;
+    cache.url = url;
+    cache.stream_provider = url.empty() ? kStreamUnknown :
+                                          FindStreamProvider(url);
+    cache.title_valid = false;
+  }
+
+  StreamingVideoProvider stream_provider = cache.stream_provider;
+  if (stream_provider != kStreamUnknown &&
+      !IsStreamSettingEnabled(stream_provider))
+    stream_provider = kStreamUnknown;
+
+  if (cache.title_valid && cache.title_provider == stream_provider &&
+      cache.title == title) {
+    title = cache.clean_title;
+    return title;
   }
 
+  cache.title = title;
+  cache.title_provider = stream_provider;
+
   // Clean-up title
   EraseLeft(title, L"New Tab");
   CleanStreamTitle(stream_provider, title);
 
+  cache.clean_title = title;
+  cache.title_valid = true;
+
   return title;
 }
\ No newline at end of file
@@ -91,9 +91,6 @@ static anime::Item* FindAnimeItem(const DirectoryChangeNotification& notificatio
       break;
   }
 
-  if (!Meow.Parse(path, parse_options, episode))
-    return nullptr;
-
   static track::recognition::MatchOptions match_options;
   switch (notification.type) {
     case DirectoryChangeNotification::kTypeDirectory:
@@ -111,9 +108,10 @@ static anime::Item* FindAnimeItem(const DirectoryChangeNotification& notificatio
       break;
   }
 
-  auto anime_id = Meow.Identify(episode, false, match_options);
+  if (!Meow.Recognize(path, parse_options, match_options, episode))
+    return nullptr;
 
-  return AnimeDatabase.FindItem(anime_id);
+  return AnimeDatabase.FindItem(episode.anime_id);
 }
 
 void FolderMonitor::OnDirectory(const DirectoryChangeNotification& notification) const {
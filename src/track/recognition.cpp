@@ -16,10 +16,13 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include <anitomy/anitomy/anitomy.h>
 #include <anitomy/anitomy/keyword.h>
 
 #include "base/log.h"
+#include "base/metrics.h"
 #include "base/string.h"
 #include "library/anime.h"
 #include "library/anime_db.h"
@@ -33,8 +36,98 @@ track::recognition::Engine Meow;
 namespace track {
 namespace recognition {
 
+// Defined at namespace scope rather than inside GetTitleFromPath, because
+// function-local statics are not initialized in a thread-safe manner.
+static const std::set<std::wstring> invalid_directory_names{
+  L"ANIME", L"DOWNLOAD", L"DOWNLOADS", L"EXTRA", L"EXTRAS",
+};
+
+static base::Metric parse_metric(
+    L"Recognition/Parse", base::Metric::kDuration);
+static base::Metric identify_metric(
+    L"Recognition/Identify", base::Metric::kDuration);
+static base::Metric lookup_metric(
+    L"Recognition/LookUpTitle", base::Metric::kCount);
+static base::Metric lookup_exact_hit_metric(
+    L"Recognition/LookUpTitle/Exact hit", base::Metric::kCount);
+static base::Metric lookup_normal_hit_metric(
+    L"Recognition/LookUpTitle/Normal hit", base::Metric::kCount);
+
+ParserContext::ParserContext()
+    : file_parsers_ready_(false) {
+  media_parser_.options().allowed_delimiters = L" ";
+
+  season_parser_.options().parse_episode_number = false;
+  season_parser_.options().parse_episode_title = false;
+  season_parser_.options().parse_file_extension = false;
+  season_parser_.options().parse_release_group = false;
+
+  title_parser_.options().parse_episode_number = false;
+  title_parser_.options().parse_episode_title = false;
+  title_parser_.options().parse_file_extension = false;
+  title_parser_.options().parse_release_group = true;
+}
+
+anitomy::Anitomy& ParserContext::file_parser(bool streaming_media) {
+  UpdateFileParsers();
+  return streaming_media ? media_parser_ : file_parser_;
+}
+
+anitomy::Anitomy& ParserContext::season_parser() {
+  return season_parser_;
+}
+
+anitomy::Anitomy& ParserContext::title_parser() {
+  return title_parser_;
+}
+
+const ParserContext::DirectoryInfo* ParserContext::FindDirectory(
+    const std::wstring& folder) {
+  // Directory names are parsed relative to the library folders
+  if (library_folders_ != Settings.library_folders) {
+    library_folders_ = Settings.library_folders;
+    directories_.clear();
+  }
+
+  auto it = directories_.find(folder);
+  return it != directories_.end() ? &it->second : nullptr;
+}
+
+void ParserContext::AddDirectory(const std::wstring& folder,
+                                 const DirectoryInfo& info) {
+  if (directories_.size() >= kMaxDirectories)
+    directories_.clear();
+
+  directories_[folder] = info;
+}
+
+void ParserContext::UpdateFileParsers() {
+  const auto& ignored_strings = Settings[taiga::kRecognition_IgnoredStrings];
+
+  if (file_parsers_ready_ && ignored_strings == ignored_strings_)
+    return;
+
+  std::vector<std::wstring> split_strings;
+  Split(ignored_strings, L"|", split_strings);
+  file_parser_.options().ignored_strings = split_strings;
+  media_parser_.options().ignored_strings = split_strings;
+
+  ignored_strings_ = ignored_strings;
+  file_parsers_ready_ = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Engine::Engine()
+    : title_update_depth_(0),
+      facts_outdated_(false),
+      titles_initialized_(false) {
+}
+
 bool Engine::Parse(std::wstring filename, const ParseOptions& parse_options,
                    anime::Episode& episode) const {
+  base::ScopedTimer timer(parse_metric);
+
   // Clear previous data
   episode.Clear();
 
@@ -49,13 +142,8 @@ bool Engine::Parse(std::wstring filename, const ParseOptions& parse_options,
   if (filename.empty())
     return false;
 
-  anitomy::Anitomy anitomy_instance;
-
-  // Set Anitomy options
-  if (parse_options.streaming_media)
-    anitomy_instance.options().allowed_delimiters = L" ";
-  Split(Settings[taiga::kRecognition_IgnoredStrings], L"|",
-        anitomy_instance.options().ignored_strings);
+  auto& anitomy_instance =
+      parser_context_.file_parser(parse_options.streaming_media);
 
   if (!anitomy_instance.Parse(filename)) {
     LOG(LevelDebug, L"Could not parse filename: " + filename);
@@ -72,10 +160,60 @@ bool Engine::Parse(std::wstring filename, const ParseOptions& parse_options,
 
 int Engine::Identify(anime::Episode& episode, bool give_score,
                      const MatchOptions& match_options) {
-  std::set<int> anime_ids;
+  InitializeTitles();
+
+  int anime_id = Identify(episode, give_score, match_options,
+                          parser_context_, candidates_, kMaxScores);
+  SetScores(candidates_);
+
+  return anime_id;
+}
 
+// Uses the parser context of the engine, so this must be called from the main
+// thread. Other threads should pass their own context to the overload below.
+IdentifyResult Engine::IdentifyCandidates(anime::Episode& episode,
+                                          const MatchOptions& match_options,
+                                          size_t max_candidates) {
   InitializeTitles();
 
+  return IdentifyCandidates(episode, match_options, parser_context_,
+                            max_candidates);
+}
+
+// Scores the alternatives even if the lookup was decisive, and leaves the
+// scores of the engine untouched. Like Identify, this can be called
+// concurrently once the titles are initialized.
+IdentifyResult Engine::IdentifyCandidates(anime::Episode& episode,
+                                          const MatchOptions& match_options,
+                                          ParserContext& parser_context,
+                                          size_t max_candidates) const {
+  IdentifyResult result;
+  result.anime_id_ = Identify(episode, true, match_options, parser_context,
+                              result.candidates_, max_candidates);
+
+  if (result.candidates_.empty() && anime::IsValidId(result.anime_id_)) {
+    std::set<int> anime_ids;
+    ScoreTitle(episode, anime_ids, match_options, result.candidates_,
+               max_candidates);
+  }
+
+  return result;
+}
+
+// Does not modify the state of the engine, and can be called concurrently once
+// the titles are initialized, as long as each thread has its own parser context
+// and candidates.
+int Engine::Identify(anime::Episode& episode, bool give_score,
+                     const MatchOptions& match_options,
+                     ParserContext& parser_context,
+                     candidates_t& candidates,
+                     size_t max_candidates) const {
+  base::ScopedTimer timer(identify_metric);
+
+  candidates.clear();
+
+  std::set<int> anime_ids;
+
   auto valide_ids = [&](anime::Episode& episode) {
     for (auto it = anime_ids.begin(); it != anime_ids.end(); ) {
       if (!ValidateOptions(episode, *it, match_options, true)) {
@@ -107,16 +245,14 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
   // Look up anime title + episode number + episode title
   if (!episode.elements().empty(anitomy::kElementEpisodeNumber) &&
       !episode.elements().empty(anitomy::kElementEpisodeTitle)) {
-    static const auto elements =
-        {anitomy::kElementEpisodeNumber, anitomy::kElementEpisodeTitle};
-    look_up_merged_title(elements);
+    look_up_merged_title(
+        {anitomy::kElementEpisodeNumber, anitomy::kElementEpisodeTitle});
   }
   // Look up anime title + episode number
   if (!episode.elements().empty(anitomy::kElementEpisodeNumber) &&
       (episode.elements().empty(anitomy::kElementFileExtension) ||
        !episode.elements().empty(anitomy::kElementAnimeType))) {
-    static const auto elements = {anitomy::kElementEpisodeNumber};
-    look_up_merged_title(elements);
+    look_up_merged_title({anitomy::kElementEpisodeNumber});
   }
 
   // Look up anime title
@@ -131,7 +267,7 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
       episode.anime_type().empty()) {
     anime::Episode episode_from_directory(episode);
     episode_from_directory.elements().erase(anitomy::kElementAnimeTitle);
-    if (GetTitleFromPath(episode_from_directory)) {
+    if (GetTitleFromPath(episode_from_directory, parser_context)) {
       LookUpTitle(episode_from_directory.anime_title(), anime_ids);
       valide_ids(episode_from_directory);
       if (!anime_ids.empty()) {
@@ -154,9 +290,10 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
   } else if (anime_ids.size() == 1) {
     episode.anime_id = *anime_ids.begin();
   } else if (anime_ids.size() > 1) {
-    episode.anime_id = ScoreTitle(episode, anime_ids, match_options);
+    episode.anime_id = ScoreTitle(episode, anime_ids, match_options,
+                                  candidates, max_candidates);
   } else if (anime_ids.empty() && give_score) {
-    ScoreTitle(episode, anime_ids, match_options);
+    ScoreTitle(episode, anime_ids, match_options, candidates, max_candidates);
   }
 
   // Post-processing
@@ -188,7 +325,43 @@ bool Engine::Search(const std::wstring& title, std::vector<int>& anime_ids) {
 
   InitializeTitles();
 
-  ScoreTitle(episode, empty_set, default_options);
+  // Titles that contain the query are found through the text index, and only
+  // those are ranked. We fall back to scoring the whole database otherwise.
+  std::vector<int> candidate_ids;
+  std::set<int> matching_ids;
+  if (AnimeDatabase.text_index.Find(title, anime::kTextIndexTitles,
+                                    candidate_ids)) {
+    std::vector<std::wstring> titles;
+    for (const auto& id : candidate_ids) {
+      titles.clear();
+      anime::GetAllTitles(id, titles);
+      for (const auto& candidate_title : titles) {
+        if (InStr(candidate_title, title, 0, true) > -1) {
+          matching_ids.insert(id);
+          break;
+        }
+      }
+    }
+  }
+
+  if (!matching_ids.empty()) {
+    ScoreTitle(episode, matching_ids, default_options, candidates_, kMaxScores);
+    SetScores(candidates_);
+    for (const auto& score : scores_) {
+      anime_ids.push_back(score.first);
+      matching_ids.erase(score.first);
+    }
+    // Matches that scored too low fill the remaining places, so that a short
+    // and common query still returns a bounded list
+    for (auto it = matching_ids.begin();
+         it != matching_ids.end() && anime_ids.size() < kMaxScores; ++it) {
+      anime_ids.push_back(*it);
+    }
+    return true;
+  }
+
+  ScoreTitle(episode, empty_set, default_options, candidates_, kMaxScores);
+  SetScores(candidates_);
 
   for (const auto& score : scores_) {
     anime_ids.push_back(score.first);
@@ -200,85 +373,177 @@ bool Engine::Search(const std::wstring& title, std::vector<int>& anime_ids) {
 ////////////////////////////////////////////////////////////////////////////////
 
 void Engine::InitializeTitles() {
-  static bool initialized = false;
-
-  if (!initialized) {
-    initialized = true;
+  if (!titles_initialized_) {
+    titles_initialized_ = true;
+    LoadTitleIndex();
     for (const auto& it : AnimeDatabase.items) {
       UpdateTitles(it.second);
     }
+    UnloadTitleIndex();
 
     ReadRelations();
+    BuildFacts();
   }
 }
 
 void Engine::UpdateTitles(const anime::Item& anime_item, bool erase_ids) {
   const int anime_id = anime_item.GetId();
 
-  db_[anime_id].normal_titles.clear();
-  db_[anime_id].trigrams.clear();
+  std::vector<std::wstring> titles;
+  std::vector<int> title_types;
 
-  if (erase_ids) {
-    auto erase_id = [&anime_id](Titles::container_t& titles) {
-      for (auto& title : titles) {
-        title.second.erase(anime_id);
-      }
-    };
-    erase_id(titles_.alternative);
-    erase_id(titles_.main);
-    erase_id(titles_.user);
-    erase_id(normal_titles_.alternative);
-    erase_id(normal_titles_.main);
-    erase_id(normal_titles_.user);
-  }
-
-  auto update_title = [&](std::wstring title,
-                          Titles::container_t& titles,
-                          Titles::container_t& normal_titles) {
+  auto add_title = [&](const std::wstring& title, int title_type) {
     if (!title.empty()) {
-      Normalize(title, kNormalizeForTrigrams, false);
-      trigram_container_t trigrams;
-      GetTrigrams(title, trigrams);
-      db_[anime_id].trigrams.push_back(trigrams);
-      db_[anime_id].normal_titles.push_back(title);
-
-      Normalize(title, kNormalizeForLookup, true);
-      titles[title].insert(anime_id);
-
-      Normalize(title, kNormalizeFull, true);
-      normal_titles[title].insert(anime_id);
+      titles.push_back(title);
+      title_types.push_back(title_type);
     }
   };
 
-  update_title(anime_item.GetTitle(), titles_.main, normal_titles_.main);
-  update_title(anime_item.GetEnglishTitle(), titles_.main, normal_titles_.main);
+  add_title(anime_item.GetTitle(), kTitleMain);
+  add_title(anime_item.GetEnglishTitle(), kTitleMain);
 
   const auto& date = anime_item.GetDateStart();
   if (anime::IsValidDate(date)) {
     std::wstring year = ToWstr(date.year);
-    if (anime_item.GetTitle().find(year) == std::wstring::npos) {
-      update_title(anime_item.GetTitle() + L" (" + year + L")",
-                   titles_.alternative, normal_titles_.alternative);
+    if (anime_item.GetTitle().find(year) == std::wstring::npos)
+      add_title(anime_item.GetTitle() + L" (" + year + L")", kTitleAlternative);
+  }
+
+  for (const auto& synonym : anime_item.GetSynonyms())
+    add_title(synonym, kTitleAlternative);
+  for (const auto& synonym : anime_item.GetUserSynonyms())
+    add_title(synonym, kTitleUser);
+
+  auto& store = db_[anime_id];
+
+  // Most updates (e.g. after downloading the list) do not change any titles,
+  // in which case there is nothing to normalize or reindex.
+  if (!erase_ids && store.titles == titles && store.title_types == title_types)
+    return;
+
+  const bool deferred = title_update_depth_ > 0;
+  if (deferred) {
+    // Postings are removed for all pending IDs at once in CommitTitleUpdate
+    pending_titles_[anime_id];
+  } else {
+    RemoveFromTrigramIndex(anime_id);
+  }
+  store.titles.clear();
+  store.title_types.clear();
+  store.normal_titles.clear();
+  store.trigrams.clear();
+
+  if (erase_ids) {
+    titles_.alternative.Erase(anime_id);
+    titles_.main.Erase(anime_id);
+    titles_.user.Erase(anime_id);
+    normal_titles_.alternative.Erase(anime_id);
+    normal_titles_.main.Erase(anime_id);
+    normal_titles_.user.Erase(anime_id);
+  }
+
+  std::set<std::wstring> updated_titles;
+
+  for (size_t i = 0; i < titles.size(); ++i) {
+    Titles::container_t* title_table = &titles_.main;
+    Titles::container_t* normal_title_table = &normal_titles_.main;
+    if (title_types.at(i) == kTitleAlternative) {
+      title_table = &titles_.alternative;
+      normal_title_table = &normal_titles_.alternative;
+    } else if (title_types.at(i) == kTitleUser) {
+      title_table = &titles_.user;
+      normal_title_table = &normal_titles_.user;
     }
+
+    NormalTitle normal_title;
+    NormalizeTitle(anime_id, titles.at(i), normal_title);
+    store.titles.push_back(titles.at(i));
+    store.title_types.push_back(title_types.at(i));
+    store.normal_titles.push_back(normal_title.trigram_title);
+    store.trigrams.push_back(normal_title.trigrams);
+
+    title_table->Insert(normal_title.lookup_title, anime_id);
+    normal_title_table->Insert(normal_title.full_title, anime_id);
+    updated_titles.insert(normal_title.full_title);
   }
 
-  for (const auto& synonym : anime_item.GetSynonyms()) {
-    update_title(synonym, titles_.alternative, normal_titles_.alternative);
+  if (deferred) {
+    auto& pending = pending_titles_[anime_id];
+    pending.insert(updated_titles.begin(), updated_titles.end());
+  } else {
+    AddToTrigramIndex(anime_id);
+    InvalidateCache(anime_id, updated_titles);
   }
-  for (const auto& synonym : anime_item.GetUserSynonyms()) {
-    update_title(synonym, titles_.user, normal_titles_.user);
+}
+
+// Defers the trigram index, cache and fact updates until CommitTitleUpdate is
+// called, so that a bulk update (e.g. downloading the whole list) refreshes
+// them only once. Calls can be nested.
+void Engine::BeginTitleUpdate() {
+  ++title_update_depth_;
+}
+
+void Engine::CommitTitleUpdate() {
+  if (title_update_depth_ == 0 || --title_update_depth_ > 0)
+    return;
+
+  if (!pending_titles_.empty()) {
+    auto is_pending = [&](const TrigramPosting& posting) {
+      return pending_titles_.count(posting.anime_id) > 0;
+    };
+    for (auto it = trigram_index_.begin(); it != trigram_index_.end(); ) {
+      auto& container = it->second;
+      container.erase(std::remove_if(container.begin(), container.end(),
+                                     is_pending),
+                      container.end());
+      if (container.empty()) {
+        it = trigram_index_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    for (const auto& it : pending_titles_) {
+      AddToTrigramIndex(it.first);
+      InvalidateCache(it.first, it.second);
+    }
+    pending_titles_.clear();
   }
+
+  if (facts_outdated_) {
+    facts_outdated_ = false;
+    BuildFacts();
+    // Erasing the entries of each updated ID would cost more than starting
+    // over after a bulk update
+    ClearCache();
+  }
+}
+
+void Engine::NormalizeTitle(int anime_id, const std::wstring& title,
+                            NormalTitle& normal_title) {
+  if (FindInTitleIndex(anime_id, title, normal_title))
+    return;
+
+  normal_title.trigram_title = title;
+  Normalize(normal_title.trigram_title, kNormalizeForTrigrams, false);
+  GetTrigrams(normal_title.trigram_title, normal_title.trigrams);
+
+  normal_title.lookup_title = normal_title.trigram_title;
+  Normalize(normal_title.lookup_title, kNormalizeForLookup, true);
+
+  normal_title.full_title = normal_title.lookup_title;
+  Normalize(normal_title.full_title, kNormalizeFull, true);
 }
 
 int Engine::LookUpTitle(std::wstring title, std::set<int>& anime_ids) const {
   int anime_id = anime::ID_UNKNOWN;
 
+  lookup_metric.Add();
+
   auto find_title = [&](const std::wstring& title,
                         const Titles::container_t& container) {
     if (!anime::IsValidId(anime_id)) {
-      auto it = container.find(title.c_str());
-      if (it != container.end()) {
-        anime_ids.insert(it->second.begin(), it->second.end());
+      if (container.Find(title, anime_ids)) {
         if (anime_ids.size() == 1)
           anime_id = *anime_ids.begin();
       }
@@ -290,14 +555,19 @@ int Engine::LookUpTitle(std::wstring title, std::set<int>& anime_ids) const {
   find_title(title, titles_.main);
   find_title(title, titles_.alternative);
 
-  if (anime_ids.size() == 1)
+  if (anime_ids.size() == 1) {
+    lookup_exact_hit_metric.Add();
     return anime_id;
+  }
 
   Normalize(title, kNormalizeFull, true);
   find_title(title, normal_titles_.user);
   find_title(title, normal_titles_.main);
   find_title(title, normal_titles_.alternative);
 
+  if (!anime_ids.empty())
+    lookup_normal_hit_metric.Add();
+
   return anime_id;
 }
 
@@ -341,11 +611,10 @@ void Engine::ExtendAnimeTitle(anime::Episode& episode) const {
   }
 }
 
-bool Engine::GetTitleFromPath(anime::Episode& episode) {
-  if (episode.folder.empty())
-    return false;
-
-  std::wstring path = episode.folder;
+void Engine::GetInfoFromDirectories(const std::wstring& folder,
+                                    ParserContext& parser_context,
+                                    ParserContext::DirectoryInfo& info) const {
+  std::wstring path = folder;
 
   for (const auto& library_folder : Settings.library_folders) {
     if (StartsWith(path, library_folder)) {
@@ -361,11 +630,8 @@ bool Engine::GetTitleFromPath(anime::Episode& episode) {
   auto is_invalid_string = [](std::wstring str) {
     if (str.find(L':') != str.npos)  // drive letter
       return true;
-    static std::set<std::wstring> invalid_strings{
-      L"ANIME", L"DOWNLOAD", L"DOWNLOADS", L"EXTRA", L"EXTRAS",
-    };
     ToUpper(str);
-    if (invalid_strings.count(str) > 0)
+    if (invalid_directory_names.count(str) > 0)
       return true;
     anitomy::keyword_manager.Normalize(str);
     anitomy::ElementCategory category = anitomy::kElementUnknown;
@@ -373,12 +639,8 @@ bool Engine::GetTitleFromPath(anime::Episode& episode) {
     return anitomy::keyword_manager.Find(str, category, options);
   };
 
-  auto get_season_number = [](const std::wstring& str) {
-    anitomy::Anitomy anitomy_instance;
-    anitomy_instance.options().parse_episode_number = false;
-    anitomy_instance.options().parse_episode_title = false;
-    anitomy_instance.options().parse_file_extension = false;
-    anitomy_instance.options().parse_release_group = false;
+  auto get_season_number = [&parser_context](const std::wstring& str) {
+    auto& anitomy_instance = parser_context.season_parser();
     anitomy_instance.Parse(str);
     auto it = anitomy_instance.elements().find(anitomy::kElementAnimeSeason);
     if (it != anitomy_instance.elements().end())
@@ -398,29 +660,46 @@ bool Engine::GetTitleFromPath(anime::Episode& episode) {
       break;
     int number = get_season_number(directory);
     if (number) {
-      if (!episode.anime_season())
-        episode.set_anime_season(number);
+      if (!info.anime_season)
+        info.anime_season = number;
     } else {
-      episode.set_anime_title(directory);
+      info.has_anime_title = true;
+      info.anime_title = directory;
       break;
     }
   }
 
-  if (episode.anime_title().empty()) {
-    return false;
-  } else {
+  if (info.has_anime_title) {
     // We're parsing the directory name in case it looks like
     // "[Fansub] Anime Title [Stuff]" rather than just "Anime Title".
-    anitomy::Anitomy anitomy_instance;
-    anitomy_instance.options().parse_episode_number = false;
-    anitomy_instance.options().parse_episode_title = false;
-    anitomy_instance.options().parse_file_extension = false;
-    anitomy_instance.options().parse_release_group = true;
-    if (anitomy_instance.Parse(episode.anime_title())) {
+    auto& anitomy_instance = parser_context.title_parser();
+    if (anitomy_instance.Parse(info.anime_title)) {
       auto elements = anitomy_instance.elements();
-      episode.set_anime_title(elements.get(anitomy::kElementAnimeTitle));
+      info.anime_title = elements.get(anitomy::kElementAnimeTitle);
     }
   }
+}
+
+bool Engine::GetTitleFromPath(anime::Episode& episode,
+                              ParserContext& parser_context) const {
+  if (episode.folder.empty())
+    return false;
+
+  // Files in the same folder share the result, so the directories are only
+  // parsed once per folder.
+  const auto* directory_info = parser_context.FindDirectory(episode.folder);
+  if (!directory_info) {
+    ParserContext::DirectoryInfo info = {0, false, std::wstring()};
+    GetInfoFromDirectories(episode.folder, parser_context, info);
+    parser_context.AddDirectory(episode.folder, info);
+    directory_info = parser_context.FindDirectory(episode.folder);
+  }
+
+  if (directory_info->anime_season && !episode.anime_season())
+    episode.set_anime_season(directory_info->anime_season);
+  if (!directory_info->has_anime_title)
+    return false;
+  episode.set_anime_title(directory_info->anime_title);
 
   auto find_number_in_string = [](const std::wstring& str) {
     auto it = std::find_if(str.begin(), str.end(), IsNumericChar);
@@ -24,8 +24,12 @@
 #include <string>
 #include <vector>
 
+#include <anitomy/anitomy/anitomy.h>
+
 #include "base/string.h"
 
+class Date;
+
 namespace anime {
 class Episode;
 class Item;
@@ -37,6 +41,41 @@ namespace recognition {
 typedef std::map<int, double> scores_t;
 typedef std::vector<std::pair<int, double>> sorted_scores_t;
 
+// Score of an anime, along with the individual scores that it is made of.
+struct Candidate {
+  int anime_id;
+  double score;
+  double jaro_winkler;
+  double levenshtein;
+  double custom;
+  double trigram;
+  double bonus;
+};
+
+typedef std::vector<Candidate> candidates_t;
+
+// Identified anime ID, along with the best candidates in descending order of
+// score. Results can be moved, but not copied.
+class IdentifyResult {
+public:
+  IdentifyResult();
+  IdentifyResult(IdentifyResult&& result);
+
+  IdentifyResult& operator=(IdentifyResult&& result);
+
+  int anime_id() const;
+  const candidates_t& candidates() const;
+
+private:
+  IdentifyResult(const IdentifyResult&);
+  IdentifyResult& operator=(const IdentifyResult&);
+
+  int anime_id_;
+  candidates_t candidates_;
+
+  friend class Engine;
+};
+
 struct ParseOptions {
   bool parse_path = false;
   bool streaming_media = false;
@@ -49,14 +88,112 @@ struct MatchOptions {
   bool check_episode_number = false;
 };
 
+// Maps normalized titles to the anime they belong to. Titles are stored in a
+// single buffer and found through an open-addressing hash table, and each anime
+// ID keeps track of the titles it appears in, so that it can be erased without
+// visiting every title.
+class TitleTable {
+public:
+  TitleTable();
+
+  void Clear();
+  void Erase(int anime_id);
+  bool Find(const std::wstring& title, std::set<int>& anime_ids) const;
+  void Insert(const std::wstring& title, int anime_id);
+
+private:
+  static const size_t kInlineIds = 2;
+
+  struct Key {
+    size_t inline_id_count() const {
+      return id_count < kInlineIds ? id_count : kInlineIds;
+    }
+
+    size_t offset;
+    size_t length;
+    unsigned int hash;
+    size_t id_count;
+    int ids[kInlineIds];
+    std::vector<int> more_ids;
+  };
+
+  static unsigned int Hash(const std::wstring& title);
+
+  size_t FindSlot(const std::wstring& title, unsigned int hash) const;
+  void Rehash(size_t slot_count);
+
+  std::vector<wchar_t> buffer_;
+  std::vector<Key> keys_;
+  std::vector<unsigned int> slots_;  // key index + 1, or 0 for empty slots
+  std::map<int, std::vector<unsigned int>> key_indexes_;
+};
+
+// Keeps configured parser instances around, so that they are not set up again
+// for every call. The file parsers are rebuilt only when the ignored strings
+// change. A context must not be used by more than one thread at a time.
+class ParserContext {
+public:
+  // What a parent directory tells about the files inside it
+  struct DirectoryInfo {
+    int anime_season;
+    bool has_anime_title;
+    std::wstring anime_title;
+  };
+
+  ParserContext();
+
+  anitomy::Anitomy& file_parser(bool streaming_media);
+  anitomy::Anitomy& season_parser();
+  anitomy::Anitomy& title_parser();
+
+  const DirectoryInfo* FindDirectory(const std::wstring& folder);
+  void AddDirectory(const std::wstring& folder, const DirectoryInfo& info);
+
+private:
+  // Number of directories that are remembered before starting over, enough
+  // to hold the folders of a scan or a burst of monitor notifications
+  static const size_t kMaxDirectories = 256;
+
+  void UpdateFileParsers();
+
+  std::map<std::wstring, DirectoryInfo> directories_;
+  std::vector<std::wstring> library_folders_;
+  bool file_parsers_ready_;
+  std::wstring ignored_strings_;
+  anitomy::Anitomy file_parser_;
+  anitomy::Anitomy media_parser_;
+  anitomy::Anitomy season_parser_;
+  anitomy::Anitomy title_parser_;
+};
+
+struct CacheStats {
+  size_t hits;
+  size_t misses;
+  size_t size;
+};
+
 class Engine {
 public:
+  Engine();
+
   bool Parse(std::wstring filename, const ParseOptions& parse_options, anime::Episode& episode) const;
   int Identify(anime::Episode& episode, bool give_score, const MatchOptions& match_options);
+  IdentifyResult IdentifyCandidates(anime::Episode& episode, const MatchOptions& match_options, size_t max_candidates = 5);
+  IdentifyResult IdentifyCandidates(anime::Episode& episode, const MatchOptions& match_options, ParserContext& parser_context, size_t max_candidates = 5) const;
+  void IdentifyBatch(std::vector<anime::Episode>& episodes, const MatchOptions& match_options);
   bool Search(const std::wstring& title, std::vector<int>& anime_ids);
+  bool Recognize(const std::wstring& input, const ParseOptions& parse_options, const MatchOptions& match_options, anime::Episode& episode, bool give_score = false);
+  void RecognizeBatch(const std::vector<std::wstring>& inputs, const ParseOptions& parse_options, const MatchOptions& match_options, std::vector<anime::Episode>& episodes);
+
+  void ClearCache();
+  CacheStats GetCacheStats() const;
 
   void InitializeTitles();
   void UpdateTitles(const anime::Item& anime_item, bool erase_ids = false);
+  void UpdateFacts(int anime_id);
+  void BeginTitleUpdate();
+  void CommitTitleUpdate();
+  void SaveTitleIndex() const;
 
   sorted_scores_t GetScores() const;
 
@@ -71,6 +208,9 @@ public:
   bool SearchEpisodeRedirection(int id, const std::pair<int, int>& range, int& destination_id, std::pair<int, int>& destination_range) const;
 
 private:
+  // Number of scores that are kept for GetScores and Search
+  static const size_t kMaxScores = 20;
+
   enum NormalizationType {
     kNormalizeMinimal,
     kNormalizeForTrigrams,
@@ -81,36 +221,94 @@ private:
   bool ValidateOptions(anime::Episode& episode, int anime_id, const MatchOptions& match_options, bool redirect) const;
   bool ValidateOptions(anime::Episode& episode, const anime::Item& anime_item, const MatchOptions& match_options, bool redirect) const;
   bool ValidateEpisodeNumber(anime::Episode& episode, const anime::Item& anime_item, const MatchOptions& match_options, bool redirect) const;
+  void FilterCandidates(anime::Episode& episode, const MatchOptions& match_options, scores_t& candidates) const;
+
+  void BuildFacts();
+  void SetFacts(size_t index, const anime::Item& anime_item);
+  void UpdateRelationFacts();
+  bool HasRelations(int anime_id) const;
+
+  void AddToCache(const std::pair<std::wstring, int>& key, const Date& date, bool parsed, const anime::Episode& episode, const sorted_scores_t& scores);
+  void InvalidateCache(int anime_id, const std::set<std::wstring>& normal_titles);
 
   int LookUpTitle(std::wstring title, std::set<int>& anime_ids) const;
-  bool GetTitleFromPath(anime::Episode& episode);
+  int Identify(anime::Episode& episode, bool give_score, const MatchOptions& match_options, ParserContext& parser_context, candidates_t& candidates, size_t max_candidates) const;
+  bool GetTitleFromPath(anime::Episode& episode, ParserContext& parser_context) const;
+  void GetInfoFromDirectories(const std::wstring& folder, ParserContext& parser_context, ParserContext::DirectoryInfo& info) const;
   void ExtendAnimeTitle(anime::Episode& episode) const;
 
-  int ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids, const MatchOptions& match_options);
-  int ScoreTitle(const std::wstring& str, const anime::Episode& episode, const scores_t& trigram_results);
+  int ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids, const MatchOptions& match_options, candidates_t& candidates, size_t max_candidates) const;
+  int ScoreTitle(const std::wstring& str, const anime::Episode& episode, const scores_t& trigram_results, candidates_t& candidates, size_t max_candidates) const;
+  void SetScores(const candidates_t& candidates);
 
   void Normalize(std::wstring& title, int type, bool normalized_before) const;
   void NormalizeUnicode(std::wstring& str) const;
+  void NormalizeAscii(std::wstring& str) const;
   void ErasePunctuation(std::wstring& str, int type, bool modified_tail) const;
-  void EraseUnnecessary(std::wstring& str) const;
-  void ConvertOrdinalNumbers(std::wstring& str) const;
-  void ConvertRomanNumbers(std::wstring& str) const;
-  void ConvertSeasonNumbers(std::wstring& str) const;
   void Transliterate(std::wstring& str) const;
 
+  struct NormalTitle {
+    std::wstring trigram_title;
+    std::wstring lookup_title;
+    std::wstring full_title;
+    trigram_container_t trigrams;
+  };
+  void NormalizeTitle(int anime_id, const std::wstring& title, NormalTitle& normal_title);
+
+  bool LoadTitleIndex();
+  void UnloadTitleIndex();
+  bool FindInTitleIndex(int anime_id, const std::wstring& title, NormalTitle& normal_title);
+
+  void AddToTrigramIndex(int anime_id);
+  void RemoveFromTrigramIndex(int anime_id);
+  void SearchTrigramIndex(const trigram_container_t& trigrams, scores_t& results) const;
+
   struct Titles {
-    typedef std::map<std::wstring, std::set<int>> container_t;
+    typedef TitleTable container_t;
     container_t alternative;
     container_t main;
     container_t user;
   } normal_titles_, titles_;
 
+  enum TitleType {
+    kTitleMain,
+    kTitleAlternative,
+    kTitleUser,
+  };
+
   struct ScoreStore {
+    std::vector<std::wstring> titles;
+    std::vector<int> title_types;
     std::vector<std::wstring> normal_titles;
     std::vector<trigram_container_t> trigrams;
   };
   std::map<int, ScoreStore> db_;
+
+  struct TrigramPosting {
+    int anime_id;
+    int title_index;
+  };
+  std::map<trigram_t, std::vector<TrigramPosting>> trigram_index_;
+
+  // What the match options are validated against, stored as a structure of
+  // arrays sorted by anime ID, so that candidates can be filtered in bulk.
+  struct Facts {
+    std::vector<int> anime_ids;
+    std::vector<int> airing_dates;  // 0 if aired, INT_MAX if never
+    std::vector<int> episode_counts;
+    std::vector<char> has_relations;
+  } facts_;
+
+  // Titles that were updated between BeginTitleUpdate and CommitTitleUpdate,
+  // whose trigram index and cache entries are yet to be refreshed.
+  std::map<int, std::set<std::wstring>> pending_titles_;
+  int title_update_depth_;
+  bool facts_outdated_;
+
+  mutable ParserContext parser_context_;
+  candidates_t candidates_;
   sorted_scores_t scores_;
+  bool titles_initialized_;
 };
 
 }  // namespace recognition
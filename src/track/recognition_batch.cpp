@@ -0,0 +1,199 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <functional>
+#include <memory>
+
+#include "library/anime_episode.h"
+#include "library/anime_util.h"
+#include "track/recognition.h"
+#include "win/win_thread.h"
+
+namespace track {
+namespace recognition {
+
+// Each worker owns a contiguous range of tasks. Once a worker runs out of
+// tasks, it steals the second half of the largest remaining range.
+class BatchWorker : public win::Thread {
+public:
+  typedef std::function<void(size_t, ParserContext&, candidates_t&)> task_t;
+
+  BatchWorker(std::vector<std::unique_ptr<BatchWorker>>& workers,
+              const task_t& task);
+
+  DWORD ThreadProc();
+
+  void Assign(size_t begin, size_t end);
+  size_t GetRemaining();
+
+private:
+  bool Pop(size_t& index);
+  bool Steal(size_t& begin, size_t& end);
+
+  win::CriticalSection critical_section_;
+  size_t begin_;
+  size_t end_;
+  ParserContext parser_context_;  // for parsing directory names
+  candidates_t candidates_;  // scratch space for ScoreTitle
+  const task_t& task_;
+  std::vector<std::unique_ptr<BatchWorker>>& workers_;
+};
+
+BatchWorker::BatchWorker(std::vector<std::unique_ptr<BatchWorker>>& workers,
+                         const task_t& task)
+    : begin_(0), end_(0), task_(task), workers_(workers) {
+}
+
+DWORD BatchWorker::ThreadProc() {
+  for (;;) {
+    size_t index = 0;
+    while (Pop(index))
+      task_(index, parser_context_, candidates_);
+
+    size_t begin = 0, end = 0;
+    if (!Steal(begin, end))
+      break;
+    Assign(begin, end);
+  }
+
+  return 0;
+}
+
+void BatchWorker::Assign(size_t begin, size_t end) {
+  win::Lock lock(critical_section_);
+
+  begin_ = begin;
+  end_ = end;
+}
+
+size_t BatchWorker::GetRemaining() {
+  win::Lock lock(critical_section_);
+
+  return end_ - begin_;
+}
+
+bool BatchWorker::Pop(size_t& index) {
+  win::Lock lock(critical_section_);
+
+  if (begin_ >= end_)
+    return false;
+
+  index = begin_++;
+  return true;
+}
+
+bool BatchWorker::Steal(size_t& begin, size_t& end) {
+  for (;;) {
+    BatchWorker* victim = nullptr;
+    size_t victim_remaining = 1;  // A single task is not worth stealing
+
+    for (const auto& worker : workers_) {
+      if (worker.get() == this)
+        continue;
+      size_t remaining = worker->GetRemaining();
+      if (remaining > victim_remaining) {
+        victim = worker.get();
+        victim_remaining = remaining;
+      }
+    }
+
+    if (!victim)
+      return false;
+
+    win::Lock lock(victim->critical_section_);
+
+    // The victim might have made progress in the meantime
+    if (victim->end_ - victim->begin_ < 2)
+      continue;
+
+    begin = victim->begin_ + (victim->end_ - victim->begin_) / 2;
+    end = victim->end_;
+    victim->end_ = begin;
+    return true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static size_t GetWorkerCount(size_t task_count) {
+  // Not worth creating threads for a handful of titles
+  const size_t min_tasks_per_worker = 8;
+
+  SYSTEM_INFO system_info;
+  ::GetSystemInfo(&system_info);
+
+  size_t worker_count = system_info.dwNumberOfProcessors;
+  worker_count = min(worker_count, task_count / min_tasks_per_worker);
+  worker_count = min(worker_count, static_cast<size_t>(MAXIMUM_WAIT_OBJECTS));
+
+  return worker_count > 0 ? worker_count : 1;
+}
+
+void Engine::IdentifyBatch(std::vector<anime::Episode>& episodes,
+                           const MatchOptions& match_options) {
+  if (episodes.empty())
+    return;
+
+  // Everything that is lazily initialized must be ready before we go
+  // concurrent, since the workers only have read access to the engine.
+  InitializeTitles();
+  std::wstring title;
+  Normalize(title, kNormalizeFull, false);
+  anime::TranslateType(title);
+
+  BatchWorker::task_t task = [&](size_t index, ParserContext& parser_context,
+                                 candidates_t& candidates) {
+    Identify(episodes.at(index), false, match_options, parser_context,
+             candidates, kMaxScores);
+  };
+
+  const size_t worker_count = GetWorkerCount(episodes.size());
+  std::vector<std::unique_ptr<BatchWorker>> workers;
+  for (size_t i = 0; i < worker_count; ++i)
+    workers.push_back(std::unique_ptr<BatchWorker>(new BatchWorker(workers, task)));
+
+  const size_t chunk_size = episodes.size() / worker_count;
+  for (size_t i = 0; i < worker_count; ++i) {
+    size_t begin = i * chunk_size;
+    size_t end = i + 1 < worker_count ? begin + chunk_size : episodes.size();
+    workers.at(i)->Assign(begin, end);
+  }
+
+  std::vector<HANDLE> handles;
+  std::vector<BatchWorker*> idle_workers;
+  for (size_t i = 1; i < worker_count; ++i) {
+    if (workers.at(i)->CreateThread(nullptr, 0, 0)) {
+      handles.push_back(workers.at(i)->GetThreadHandle());
+    } else {
+      idle_workers.push_back(workers.at(i).get());
+    }
+  }
+
+  // The calling thread works on the first range, as well as the ranges of the
+  // threads that could not be created.
+  workers.front()->ThreadProc();
+  for (auto worker : idle_workers)
+    worker->ThreadProc();
+
+  if (!handles.empty())
+    ::WaitForMultipleObjects(static_cast<DWORD>(handles.size()),
+                             &handles.front(), TRUE, INFINITE);
+}
+
+}  // namespace recognition
+}  // namespace track
\ No newline at end of file
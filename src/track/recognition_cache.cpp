@@ -0,0 +1,277 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <list>
+
+#include "base/string.h"
+#include "base/time.h"
+#include "library/anime_episode.h"
+#include "library/anime_util.h"
+#include "taiga/settings.h"
+#include "track/recognition.h"
+
+namespace track {
+namespace recognition {
+
+class Cache {
+public:
+  typedef std::pair<std::wstring, int> key_t;
+
+  struct Entry {
+    key_t key;
+    Date date;  // only set if the result depends on the current date
+    bool parsed;
+    anime::Episode episode;
+    std::wstring normal_title;
+    sorted_scores_t scores;
+  };
+
+  Cache();
+
+  Entry* Find(const key_t& key, const Date& date);
+  Entry& Insert(const key_t& key, const Date& date);
+  void Clear();
+  void Erase(int anime_id, const std::set<std::wstring>& normal_titles);
+  bool Validate(const std::wstring& settings);
+
+  CacheStats stats;
+
+private:
+  static const size_t kMaxSize = 1000;
+
+  std::list<Entry> entries_;  // most recently used first
+  std::map<key_t, std::list<Entry>::iterator> keys_;
+  std::wstring settings_;
+};
+
+static Cache cache;
+
+////////////////////////////////////////////////////////////////////////////////
+
+Cache::Cache() {
+  stats.hits = 0;
+  stats.misses = 0;
+  stats.size = 0;
+}
+
+Cache::Entry* Cache::Find(const key_t& key, const Date& date) {
+  auto it = keys_.find(key);
+
+  if (it != keys_.end() && it->second->date != date) {
+    // Expired, e.g. an episode that had not aired yet might have aired today
+    entries_.erase(it->second);
+    keys_.erase(it);
+    stats.size = entries_.size();
+    it = keys_.end();
+  }
+
+  if (it == keys_.end()) {
+    stats.misses++;
+    return nullptr;
+  }
+
+  stats.hits++;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return &entries_.front();
+}
+
+Cache::Entry& Cache::Insert(const key_t& key, const Date& date) {
+  auto it = keys_.find(key);
+  if (it != keys_.end()) {
+    entries_.erase(it->second);
+    keys_.erase(it);
+  }
+
+  if (entries_.size() >= kMaxSize) {
+    keys_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+
+  entries_.push_front(Entry());
+  entries_.front().key = key;
+  entries_.front().date = date;
+  keys_[key] = entries_.begin();
+  stats.size = entries_.size();
+
+  return entries_.front();
+}
+
+void Cache::Clear() {
+  entries_.clear();
+  keys_.clear();
+  stats.size = 0;
+}
+
+void Cache::Erase(int anime_id, const std::set<std::wstring>& normal_titles) {
+  auto is_affected = [&](const Entry& entry) {
+    // Unidentified entries might be recognized with the new titles
+    if (!anime::IsValidId(entry.episode.anime_id))
+      return true;
+    if (entry.episode.anime_id == anime_id)
+      return true;
+    for (const auto& score : entry.scores)
+      if (score.first == anime_id)
+        return true;
+    // Another entry might have taken over the title
+    return normal_titles.count(entry.normal_title) > 0;
+  };
+
+  for (auto it = entries_.begin(); it != entries_.end(); ) {
+    if (is_affected(*it)) {
+      keys_.erase(it->key);
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  stats.size = entries_.size();
+}
+
+bool Cache::Validate(const std::wstring& settings) {
+  if (settings_ == settings)
+    return true;
+
+  Clear();
+  settings_ = settings;
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::wstring GetCacheSettings() {
+  // Parse and identify results also depend on these settings
+  return Settings[taiga::kRecognition_IgnoredStrings] +
+      L"|" + Settings[taiga::kRecognition_LookupParentDirectories] +
+      L"|" + Join(Settings.library_folders, L"|");
+}
+
+static Cache::key_t GetCacheKey(const std::wstring& input,
+                                const ParseOptions& parse_options,
+                                const MatchOptions& match_options,
+                                bool give_score) {
+  int flags = (parse_options.parse_path ? 0x01 : 0) |
+              (parse_options.streaming_media ? 0x02 : 0) |
+              (match_options.allow_sequels ? 0x04 : 0) |
+              (match_options.check_airing_date ? 0x08 : 0) |
+              (match_options.check_anime_type ? 0x10 : 0) |
+              (match_options.check_episode_number ? 0x20 : 0) |
+              (give_score ? 0x40 : 0);
+  return std::make_pair(input, flags);
+}
+
+static Date GetCacheDate(const MatchOptions& match_options) {
+  // Airing dates are checked against the current date
+  return match_options.check_airing_date ? GetDate() : Date();
+}
+
+bool Engine::Recognize(const std::wstring& input,
+                       const ParseOptions& parse_options,
+                       const MatchOptions& match_options,
+                       anime::Episode& episode, bool give_score) {
+  cache.Validate(GetCacheSettings());
+
+  auto key = GetCacheKey(input, parse_options, match_options, give_score);
+  auto date = GetCacheDate(match_options);
+  auto entry = cache.Find(key, date);
+
+  if (entry) {
+    episode = entry->episode;
+    if (give_score)
+      scores_ = entry->scores;
+    return entry->parsed;
+  }
+
+  // Identify might update the title tables on first use, which would in turn
+  // invalidate the cache, so we insert the new entry only afterwards.
+  bool parsed = Parse(input, parse_options, episode);
+  if (parsed)
+    Identify(episode, give_score, match_options);
+
+  AddToCache(key, date, parsed, episode,
+             give_score ? scores_ : sorted_scores_t());
+
+  return parsed;
+}
+
+void Engine::RecognizeBatch(const std::vector<std::wstring>& inputs,
+                            const ParseOptions& parse_options,
+                            const MatchOptions& match_options,
+                            std::vector<anime::Episode>& episodes) {
+  cache.Validate(GetCacheSettings());
+
+  episodes.resize(inputs.size());
+  auto date = GetCacheDate(match_options);
+
+  std::vector<size_t> indexes;
+  std::vector<anime::Episode> pending_episodes;
+
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    auto key = GetCacheKey(inputs.at(i), parse_options, match_options, false);
+    auto entry = cache.Find(key, date);
+    if (entry) {
+      episodes.at(i) = entry->episode;
+    } else if (Parse(inputs.at(i), parse_options, episodes.at(i))) {
+      indexes.push_back(i);
+      pending_episodes.push_back(episodes.at(i));
+    } else {
+      AddToCache(key, date, false, episodes.at(i), sorted_scores_t());
+    }
+  }
+
+  IdentifyBatch(pending_episodes, match_options);
+
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    size_t index = indexes.at(i);
+    episodes.at(index) = pending_episodes.at(i);
+    auto key = GetCacheKey(inputs.at(index), parse_options, match_options,
+                           false);
+    AddToCache(key, date, true, episodes.at(index), sorted_scores_t());
+  }
+}
+
+void Engine::AddToCache(const std::pair<std::wstring, int>& key,
+                        const Date& date, bool parsed,
+                        const anime::Episode& episode,
+                        const sorted_scores_t& scores) {
+  auto& entry = cache.Insert(key, date);
+  entry.parsed = parsed;
+  entry.episode = episode;
+  entry.scores = scores;
+  if (parsed) {
+    entry.normal_title = episode.anime_title();
+    Normalize(entry.normal_title, kNormalizeFull, false);
+  }
+}
+
+void Engine::ClearCache() {
+  cache.Clear();
+}
+
+CacheStats Engine::GetCacheStats() const {
+  return cache.stats;
+}
+
+void Engine::InvalidateCache(int anime_id,
+                             const std::set<std::wstring>& normal_titles) {
+  if (cache.stats.size > 0)
+    cache.Erase(anime_id, normal_titles);
+}
+
+}  // namespace recognition
+}  // namespace track
\ No newline at end of file
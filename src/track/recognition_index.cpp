@@ -0,0 +1,315 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+
+#include "base/file.h"
+#include "base/log.h"
+#include "taiga/path.h"
+#include "track/recognition.h"
+
+namespace track {
+namespace recognition {
+
+// Normalizing every title on startup is expensive, so the results are kept in
+// a binary file next to the anime database. The file is mapped into memory
+// while the titles are initialized, and each entry is only used if its source
+// title is still the same.
+//
+// Layout (native byte order, strings are prefixed with their length):
+//   header:  signature, format version, normalizer version, database time,
+//            item count
+//   item:    anime ID, title count, titles
+//   title:   source title, trigram title, lookup title, full title,
+//            trigram count, trigrams
+
+// Increase this whenever a change to Normalize or GetTrigrams alters their
+// output, so that existing index files are discarded.
+static const uint32_t kNormalizerVersion = 1;
+
+static const uint32_t kTitleIndexSignature = 0x58495454;  // "TTIX"
+static const uint32_t kTitleIndexVersion = 1;
+
+class TitleIndexReader {
+public:
+  TitleIndexReader(const BYTE* data, size_t size, size_t position = 0);
+
+  bool Read(void* output, size_t length);
+  bool ReadString(std::wstring& str);
+  bool ReadTrigrams(trigram_container_t& trigrams);
+  bool SkipString();
+  bool SkipTrigrams();
+  bool CompareString(const std::wstring& str, bool& equal);
+
+  template <typename T>
+  bool Read(T& value) {
+    return Read(&value, sizeof(T));
+  }
+
+  size_t position() const;
+
+private:
+  bool Skip(size_t length);
+
+  const BYTE* data_;
+  size_t size_;
+  size_t position_;
+};
+
+struct TitleIndex {
+  TitleIndex() : database_time(0), modified(false) {}
+
+  MappedFile file;
+  std::map<int, size_t> entries;  // anime ID -> position of the title count
+  QWORD database_time;
+  bool modified;
+};
+
+TitleIndex title_index;
+
+////////////////////////////////////////////////////////////////////////////////
+
+TitleIndexReader::TitleIndexReader(const BYTE* data, size_t size,
+                                   size_t position)
+    : data_(data), size_(size), position_(position) {
+}
+
+bool TitleIndexReader::Read(void* output, size_t length) {
+  if (length > size_ - position_)
+    return false;
+
+  memcpy(output, data_ + position_, length);
+  position_ += length;
+  return true;
+}
+
+bool TitleIndexReader::ReadString(std::wstring& str) {
+  uint32_t length = 0;
+  if (!Read(length) || length > (size_ - position_) / sizeof(wchar_t))
+    return false;
+
+  str.resize(length);
+  return length == 0 || Read(&str[0], length * sizeof(wchar_t));
+}
+
+bool TitleIndexReader::ReadTrigrams(trigram_container_t& trigrams) {
+  uint32_t count = 0;
+  if (!Read(count) || count > (size_ - position_) / sizeof(trigram_t))
+    return false;
+
+  trigrams.resize(count);
+  return count == 0 || Read(&trigrams[0], count * sizeof(trigram_t));
+}
+
+bool TitleIndexReader::SkipString() {
+  uint32_t length = 0;
+  return Read(length) &&
+         length <= (size_ - position_) / sizeof(wchar_t) &&
+         Skip(length * sizeof(wchar_t));
+}
+
+bool TitleIndexReader::SkipTrigrams() {
+  uint32_t count = 0;
+  return Read(count) &&
+         count <= (size_ - position_) / sizeof(trigram_t) &&
+         Skip(count * sizeof(trigram_t));
+}
+
+bool TitleIndexReader::CompareString(const std::wstring& str, bool& equal) {
+  uint32_t length = 0;
+  if (!Read(length) || length > (size_ - position_) / sizeof(wchar_t))
+    return false;
+
+  equal = length == str.size() &&
+          memcmp(data_ + position_, str.data(),
+                 length * sizeof(wchar_t)) == 0;
+  return Skip(length * sizeof(wchar_t));
+}
+
+size_t TitleIndexReader::position() const {
+  return position_;
+}
+
+bool TitleIndexReader::Skip(size_t length) {
+  if (length > size_ - position_)
+    return false;
+
+  position_ += length;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+static void WriteValue(std::string& data, const T& value) {
+  data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void WriteString(std::string& data, const std::wstring& str) {
+  WriteValue(data, static_cast<uint32_t>(str.size()));
+  data.append(reinterpret_cast<const char*>(str.data()),
+              str.size() * sizeof(wchar_t));
+}
+
+static void WriteTrigrams(std::string& data,
+                          const trigram_container_t& trigrams) {
+  WriteValue(data, static_cast<uint32_t>(trigrams.size()));
+  if (!trigrams.empty())
+    data.append(reinterpret_cast<const char*>(&trigrams.front()),
+                trigrams.size() * sizeof(trigram_t));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Engine::LoadTitleIndex() {
+  UnloadTitleIndex();
+
+  // Until the file is read successfully, it will have to be rewritten
+  title_index.modified = true;
+
+  const auto path = taiga::GetPath(taiga::kPathDatabaseAnimeTitles);
+  if (!title_index.file.Open(path))
+    return false;
+
+  TitleIndexReader reader(title_index.file.data(), title_index.file.size());
+
+  auto read_entries = [&]() {
+    uint32_t signature = 0;
+    uint32_t version = 0;
+    uint32_t normalizer_version = 0;
+    uint32_t item_count = 0;
+    if (!reader.Read(signature) || signature != kTitleIndexSignature ||
+        !reader.Read(version) || version != kTitleIndexVersion ||
+        !reader.Read(normalizer_version) ||
+        normalizer_version != kNormalizerVersion ||
+        !reader.Read(title_index.database_time) ||
+        !reader.Read(item_count))
+      return false;
+
+    for (uint32_t i = 0; i < item_count; ++i) {
+      int32_t anime_id = 0;
+      if (!reader.Read(anime_id))
+        return false;
+      title_index.entries[anime_id] = reader.position();
+
+      uint32_t title_count = 0;
+      if (!reader.Read(title_count))
+        return false;
+      for (uint32_t j = 0; j < title_count; ++j) {
+        if (!reader.SkipString() || !reader.SkipString() ||
+            !reader.SkipString() || !reader.SkipString() ||
+            !reader.SkipTrigrams())
+          return false;
+      }
+    }
+
+    return true;
+  };
+
+  if (!read_entries()) {
+    LOG(LevelWarning, L"Discarding invalid or outdated title index.");
+    UnloadTitleIndex();
+    title_index.modified = true;
+    return false;
+  }
+
+  title_index.modified = false;
+  return true;
+}
+
+void Engine::UnloadTitleIndex() {
+  title_index.entries.clear();
+  title_index.file.Close();
+}
+
+bool Engine::FindInTitleIndex(int anime_id, const std::wstring& title,
+                              NormalTitle& normal_title) {
+  auto it = title_index.entries.find(anime_id);
+
+  if (it != title_index.entries.end()) {
+    TitleIndexReader reader(title_index.file.data(), title_index.file.size(),
+                            it->second);
+    uint32_t title_count = 0;
+    reader.Read(title_count);
+
+    for (uint32_t i = 0; i < title_count; ++i) {
+      bool equal = false;
+      if (!reader.CompareString(title, equal))
+        break;
+      if (equal) {
+        if (reader.ReadString(normal_title.trigram_title) &&
+            reader.ReadString(normal_title.lookup_title) &&
+            reader.ReadString(normal_title.full_title) &&
+            reader.ReadTrigrams(normal_title.trigrams))
+          return true;
+        break;
+      }
+      if (!reader.SkipString() || !reader.SkipString() ||
+          !reader.SkipString() || !reader.SkipTrigrams())
+        break;
+    }
+  }
+
+  // The title will be normalized again, and the file needs to be updated
+  title_index.modified = true;
+  return false;
+}
+
+void Engine::SaveTitleIndex() const {
+  if (!titles_initialized_)
+    return;
+
+  const auto database_time =
+      GetFileLastWriteTime(taiga::GetPath(taiga::kPathDatabaseAnime));
+  if (!title_index.modified && database_time == title_index.database_time)
+    return;
+
+  std::string data;
+  WriteValue(data, kTitleIndexSignature);
+  WriteValue(data, kTitleIndexVersion);
+  WriteValue(data, kNormalizerVersion);
+  WriteValue(data, database_time);
+  WriteValue(data, static_cast<uint32_t>(db_.size()));
+
+  for (const auto& it : db_) {
+    const auto& store = it.second;
+    WriteValue(data, static_cast<int32_t>(it.first));
+    WriteValue(data, static_cast<uint32_t>(store.titles.size()));
+    for (size_t i = 0; i < store.titles.size(); ++i) {
+      std::wstring lookup_title = store.normal_titles.at(i);
+      Normalize(lookup_title, kNormalizeForLookup, true);
+      std::wstring full_title = lookup_title;
+      Normalize(full_title, kNormalizeFull, true);
+
+      WriteString(data, store.titles.at(i));
+      WriteString(data, store.normal_titles.at(i));
+      WriteString(data, lookup_title);
+      WriteString(data, full_title);
+      WriteTrigrams(data, store.trigrams.at(i));
+    }
+  }
+
+  const auto path = taiga::GetPath(taiga::kPathDatabaseAnimeTitles);
+  if (SaveToFile(data, path)) {
+    title_index.database_time = database_time;
+    title_index.modified = false;
+  }
+}
+
+}  // namespace recognition
+}  // namespace track
\ No newline at end of file
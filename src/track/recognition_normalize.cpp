@@ -17,27 +17,183 @@
 */
 
 #include <algorithm>
+#include <cwctype>
 
 #include <utf8proc/utf8proc.h>
 
+#include "base/metrics.h"
 #include "track/recognition.h"
 
 namespace track {
 namespace recognition {
 
+// Counted rather than timed, as this is called for every candidate title
+static base::Metric normalize_metric(
+    L"Recognition/Normalize", base::Metric::kCount);
+
+// Replaces whole words in a single left-to-right scan. Patterns are stored in a
+// trie, and since a match has to begin at a word boundary, we only need to
+// walk the trie from those positions. When more than one pattern matches at
+// the same position, the longest one wins.
+class WordReplacer {
+public:
+  typedef std::vector<std::pair<std::wstring, std::wstring>> pairs_t;
+
+  explicit WordReplacer(const std::initializer_list<pairs_t>& tables);
+
+  void Replace(std::wstring& str) const;
+
+private:
+  struct Node {
+    std::vector<std::pair<wchar_t, size_t>> children;  // sorted by character
+    int replacement;
+  };
+
+  static bool IsBoundary(wchar_t c);
+  size_t FindChild(size_t node, wchar_t c) const;
+
+  std::vector<Node> nodes_;
+  std::vector<std::wstring> replacements_;
+};
+
+WordReplacer::WordReplacer(const std::initializer_list<pairs_t>& tables) {
+  Node root = {{}, -1};
+  nodes_.push_back(root);
+
+  for (const auto& table : tables) {
+    for (const auto& pair : table) {
+      size_t node = 0;
+      for (const auto& c : pair.first) {
+        size_t child = FindChild(node, c);
+        if (!child) {
+          child = nodes_.size();
+          Node new_node = {{}, -1};
+          nodes_.push_back(new_node);
+          auto& children = nodes_.at(node).children;
+          auto it = std::lower_bound(children.begin(), children.end(),
+                                     std::make_pair(c, static_cast<size_t>(0)));
+          children.insert(it, std::make_pair(c, child));
+        }
+        node = child;
+      }
+      if (nodes_.at(node).replacement == -1) {  // First one wins
+        nodes_.at(node).replacement = static_cast<int>(replacements_.size());
+        replacements_.push_back(pair.second);
+      }
+    }
+  }
+}
+
+bool WordReplacer::IsBoundary(wchar_t c) {
+  // Same definition as ReplaceString
+  return iswspace(c) || iswpunct(c);
+}
+
+size_t WordReplacer::FindChild(size_t node, wchar_t c) const {
+  const auto& children = nodes_.at(node).children;
+  auto it = std::lower_bound(children.begin(), children.end(),
+                             std::make_pair(c, static_cast<size_t>(0)));
+  return it != children.end() && it->first == c ? it->second : 0;
+}
+
+void WordReplacer::Replace(std::wstring& str) const {
+  std::wstring output;
+  output.reserve(str.size());
+
+  for (size_t pos = 0; pos < str.size(); ) {
+    if (output.empty() || IsBoundary(output.back())) {
+      int replacement = -1;
+      size_t match_end = pos;
+      size_t node = 0;
+      for (size_t i = pos; i < str.size(); ++i) {
+        node = FindChild(node, str[i]);
+        if (!node)
+          break;
+        if (nodes_[node].replacement > -1 &&
+            (i + 1 == str.size() || IsBoundary(str[i + 1]))) {
+          replacement = nodes_[node].replacement;
+          match_end = i + 1;
+        }
+      }
+      if (replacement > -1) {
+        output.append(replacements_[replacement]);
+        pos = match_end;
+        continue;
+      }
+    }
+    output.push_back(str[pos++]);
+  }
+
+  str.swap(output);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// We skip 1 and 10 to avoid matching "I" and "X", as they're unlikely to be
+// used as Roman numerals. Any number above "XIII" is rarely used in anime
+// titles, which is why we don't need an actual Roman-to-Arabic number
+// conversion algorithm.
+static const WordReplacer::pairs_t roman_numbers{
+  {L"II", L"2"}, {L"III", L"3"}, {L"IV", L"4"}, {L"V", L"5"},
+  {L"VI", L"6"}, {L"VII", L"7"}, {L"VIII", L"8"}, {L"IX", L"9"},
+  {L"XI", L"11"}, {L"XII", L"12"}, {L"XIII", L"13"},
+};
+
+// Romanizations (Hepburn to Wapuro)
+static const WordReplacer::pairs_t romanizations{
+  {L"wa", L"ha"}, {L"e", L"he"}, {L"o", L"wo"},
+};
+
+static const WordReplacer::pairs_t ordinal_numbers{
+  {L"first", L"1st"}, {L"second", L"2nd"}, {L"third", L"3rd"},
+  {L"fourth", L"4th"}, {L"fifth", L"5th"}, {L"sixth", L"6th"},
+  {L"seventh", L"7th"}, {L"eighth", L"8th"}, {L"ninth", L"9th"},
+};
+
+// Ordinal numbers used to be converted in a separate pass beforehand, so we
+// also need to cover their written forms here (e.g. "second season").
+static const WordReplacer::pairs_t season_numbers{
+  {L"1st season", L"1"}, {L"first season", L"1"}, {L"season 1", L"1"}, {L"series 1", L"1"}, {L"s1", L"1"},
+  {L"2nd season", L"2"}, {L"second season", L"2"}, {L"season 2", L"2"}, {L"series 2", L"2"}, {L"s2", L"2"},
+  {L"3rd season", L"3"}, {L"third season", L"3"}, {L"season 3", L"3"}, {L"series 3", L"3"}, {L"s3", L"3"},
+  {L"4th season", L"4"}, {L"fourth season", L"4"}, {L"season 4", L"4"}, {L"series 4", L"4"}, {L"s4", L"4"},
+  {L"5th season", L"5"}, {L"fifth season", L"5"}, {L"season 5", L"5"}, {L"series 5", L"5"}, {L"s5", L"5"},
+  {L"6th season", L"6"}, {L"sixth season", L"6"}, {L"season 6", L"6"}, {L"series 6", L"6"}, {L"s6", L"6"},
+};
+
+static const WordReplacer::pairs_t unnecessary_words{
+  {L"&", L"and"},
+  {L"the animation", L""},
+  {L"the", L""},
+  {L"episode", L""},
+  {L"oad", L"ova"},
+  {L"oav", L"ova"},
+  {L"specials", L"sp"},
+  {L"special", L"sp"},
+  {L"(tv)", L""},
+};
+
+static const WordReplacer roman_number_replacer{roman_numbers};
+static const WordReplacer romanization_replacer{romanizations};
+// Applied after case folding
+static const WordReplacer word_replacer{season_numbers, ordinal_numbers,
+                                        unnecessary_words};
+
+////////////////////////////////////////////////////////////////////////////////
+
 void Engine::Normalize(std::wstring& title, int type,
                        bool normalized_before) const {
+  normalize_metric.Add();
+
   bool modified_tail = false;
 
   if (!normalized_before) {
     const auto unmodified_title = title;
 
-    ConvertRomanNumbers(title);
+    roman_number_replacer.Replace(title);
     Transliterate(title);
     NormalizeUnicode(title);  // Title is lower case after this point, due to UTF8PROC_CASEFOLD
-    ConvertOrdinalNumbers(title);
-    ConvertSeasonNumbers(title);
-    EraseUnnecessary(title);
+    word_replacer.Replace(title);
     Trim(title);
 
     if (title.size() != unmodified_title.size() &&
@@ -56,55 +212,17 @@ void Engine::Normalize(std::wstring& title, int type,
       break;
   }
 
-  if (type < kNormalizeFull)
-    while (ReplaceString(title, 0, L"  ", L" ", false, true));
+  if (type < kNormalizeFull) {
+    auto is_double_space = [](wchar_t a, wchar_t b) {
+      return a == L' ' && b == L' ';
+    };
+    title.erase(std::unique(title.begin(), title.end(), is_double_space),
+                title.end());
+  }
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 
-void Engine::ConvertOrdinalNumbers(std::wstring& str) const {
-  static const std::vector<std::pair<std::wstring, std::wstring>> ordinals{
-    {L"1st", L"first"}, {L"2nd", L"second"}, {L"3rd", L"third"},
-    {L"4th", L"fourth"}, {L"5th", L"fifth"}, {L"6th", L"sixth"},
-    {L"7th", L"seventh"}, {L"8th", L"eighth"}, {L"9th", L"ninth"},
-  };
-
-  for (const auto& ordinal : ordinals)
-    ReplaceString(str, 0, ordinal.second, ordinal.first, true, true);
-}
-
-void Engine::ConvertRomanNumbers(std::wstring& str) const {
-  // We skip 1 and 10 to avoid matching "I" and "X", as they're unlikely to be
-  // used as Roman numerals. Any number above "XIII" is rarely used in anime
-  // titles, which is why we don't need an actual Roman-to-Arabic number
-  // conversion algorithm.
-  static const std::vector<std::pair<std::wstring, std::wstring>> numerals{
-    {L"2", L"II"}, {L"3", L"III"}, {L"4", L"IV"}, {L"5", L"V"},
-    {L"6", L"VI"}, {L"7", L"VII"}, {L"8", L"VIII"}, {L"9", L"IX"},
-    {L"11", L"XI"}, {L"12", L"XII"}, {L"13", L"XIII"},
-  };
-
-  for (const auto& numeral : numerals)
-    ReplaceString(str, 0, numeral.second, numeral.first, true, true);
-}
-
-void Engine::ConvertSeasonNumbers(std::wstring& str) const {
-  // This works considerably faster than regular expressions.
-  typedef std::vector<std::wstring> season_t;
-  static const std::vector<std::pair<std::wstring, season_t>> values{
-    {L"1", {L"1st season", L"season 1", L"series 1", L"s1"}},
-    {L"2", {L"2nd season", L"season 2", L"series 2", L"s2"}},
-    {L"3", {L"3rd season", L"season 3", L"series 3", L"s3"}},
-    {L"4", {L"4th season", L"season 4", L"series 4", L"s4"}},
-    {L"5", {L"5th season", L"season 5", L"series 5", L"s5"}},
-    {L"6", {L"6th season", L"season 6", L"series 6", L"s6"}},
-  };
-
-  for (const auto& value : values)
-    for (const auto& season : value.second)
-      ReplaceString(str, 0, season, value.first, true, true);
-}
-
 void Engine::Transliterate(std::wstring& str) const {
   for (size_t i = 0; i < str.size(); ++i) {
     auto& c = str[i];
@@ -120,10 +238,7 @@ void Engine::Transliterate(std::wstring& str) const {
     }
   }
 
-  // Romanizations (Hepburn to Wapuro)
-  ReplaceString(str, 0, L"wa", L"ha", true, true);
-  ReplaceString(str, 0, L"e", L"he", true, true);
-  ReplaceString(str, 0, L"o", L"wo", true, true);
+  romanization_replacer.Replace(str);
 }
 
 void Engine::NormalizeUnicode(std::wstring& str) const {
@@ -138,34 +253,110 @@ void Engine::NormalizeUnicode(std::wstring& str) const {
       // Perform unicode case folding for case-insensitive comparison
       UTF8PROC_CASEFOLD;
 
-  char* buffer = nullptr;
-  std::string temp = WstrToStr(str);
+  // Most titles are plain ASCII, for which the options above amount to
+  // lowercasing and stripping control characters
+  auto is_ascii = [](wchar_t c) { return c < 0x80; };
+  if (std::all_of(str.begin(), str.end(), is_ascii)) {
+    NormalizeAscii(str);
+    return;
+  }
 
-  int length = utf8proc_map(
-      reinterpret_cast<const utf8proc_uint8_t*>(temp.data()), temp.length(),
-      reinterpret_cast<utf8proc_uint8_t**>(&buffer),
-      static_cast<utf8proc_option_t>(options));
+  // Decode UTF-16 and decompose each code point straight into a UTF-32
+  // buffer, rather than converting to UTF-8 and back for utf8proc_map
+  std::vector<utf8proc_int32_t> buffer(str.size() * 2 + 1);
+  utf8proc_ssize_t length = 0;
+  int boundclass = UTF8PROC_BOUNDCLASS_START;
+
+  for (size_t i = 0; i < str.size(); ++i) {
+    utf8proc_int32_t uc = str[i];
+    if (uc >= 0xD800 && uc <= 0xDBFF && i + 1 < str.size() &&
+        str[i + 1] >= 0xDC00 && str[i + 1] <= 0xDFFF) {
+      uc = 0x10000 + ((uc - 0xD800) << 10) + (str[++i] - 0xDC00);
+    } else if (uc >= 0xD800 && uc <= 0xDFFF) {
+      uc = 0xFFFD;  // unpaired surrogate
+    }
 
-  if (length >= 0) {
-    temp.assign(buffer, length);
-    str = StrToWstr(temp);
+    utf8proc_ssize_t result = 0;
+    for (;;) {
+      utf8proc_ssize_t available = buffer.size() - length;
+      result = utf8proc_decompose_char(
+          uc, buffer.data() + length, available,
+          static_cast<utf8proc_option_t>(options), &boundclass);
+      if (result < 0)
+        return;
+      if (result < available)  // keep one spare element for reencoding
+        break;
+      buffer.resize(buffer.size() * 2 + result);
+    }
+    length += result;
+  }
+
+  // Canonical ordering of combining marks, as done by utf8proc_decompose
+  for (utf8proc_ssize_t pos = 0; pos < length - 1; ) {
+    auto& uc1 = buffer[pos];
+    auto& uc2 = buffer[pos + 1];
+    auto class1 = utf8proc_get_property(uc1)->combining_class;
+    auto class2 = utf8proc_get_property(uc2)->combining_class;
+    if (class1 > class2 && class2 > 0) {
+      std::swap(uc1, uc2);
+      if (pos > 0) --pos; else ++pos;
+    } else {
+      ++pos;
+    }
   }
 
-  if (buffer)
-    free(buffer);
+  // Composition and control character handling are left to the library. It
+  // encodes its output as UTF-8 in place, which we then decode directly.
+  length = utf8proc_reencode(buffer.data(), length,
+                             static_cast<utf8proc_option_t>(options));
+  if (length < 0)
+    return;
+
+  const auto utf8 = reinterpret_cast<const utf8proc_uint8_t*>(buffer.data());
+  str.clear();
+  for (utf8proc_ssize_t pos = 0; pos < length; ) {
+    utf8proc_int32_t uc = 0;
+    utf8proc_ssize_t bytes = utf8proc_iterate(utf8 + pos, length - pos, &uc);
+    if (bytes <= 0)
+      break;
+    pos += bytes;
+    if (uc >= 0x10000) {
+      uc -= 0x10000;
+      str.push_back(static_cast<wchar_t>(0xD800 + (uc >> 10)));
+      str.push_back(static_cast<wchar_t>(0xDC00 + (uc & 0x3FF)));
+    } else {
+      str.push_back(static_cast<wchar_t>(uc));
+    }
+  }
 }
 
-// TODO: Rename
-void Engine::EraseUnnecessary(std::wstring& str) const {
-  ReplaceString(str, 0, L"&", L"and", true, true);
-  ReplaceString(str, 0, L"the animation", L"", true, true);
-  ReplaceString(str, 0, L"the", L"", true, true);
-  ReplaceString(str, 0, L"episode", L"", true, true);
-  ReplaceString(str, 0, L"oad", L"ova", true, true);
-  ReplaceString(str, 0, L"oav", L"ova", true, true);
-  ReplaceString(str, 0, L"specials", L"sp", true, true);
-  ReplaceString(str, 0, L"special", L"sp", true, true);
-  ReplaceString(str, 0, L"(tv)", L"", true, true);
+void Engine::NormalizeAscii(std::wstring& str) const {
+  size_t length = 0;
+
+  for (size_t i = 0; i < str.size(); ++i) {
+    wchar_t c = str[i];
+    switch (c) {
+      case L'\r':
+        if (i + 1 < str.size() && str[i + 1] == L'\n')
+          ++i;
+        // fall through
+      case L'\t':
+      case L'\n':
+      case L'\v':
+      case L'\f':
+        str[length++] = L' ';
+        break;
+      default:
+        if (c >= L'A' && c <= L'Z') {
+          str[length++] = c + (L'a' - L'A');
+        } else if (c >= 0x20 && c != 0x7F) {
+          str[length++] = c;
+        }
+        break;
+    }
+  }
+
+  str.resize(length);
 }
 
 void Engine::ErasePunctuation(std::wstring& str, int type,
@@ -16,7 +16,8 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <regex>
+#include <algorithm>
+#include <climits>
 
 #include "base/file.h"
 #include "base/log.h"
@@ -30,108 +31,220 @@
 namespace track {
 namespace recognition {
 
-class Relation {
+// Episode ranges of all anime, sorted by source ID and first episode number.
+// For each rule we also keep the largest last episode number among the rules
+// of the same source ID up to that point, so that a lookup can stop as soon as
+// no earlier rule can contain the episode.
+class RelationTable {
 public:
   typedef std::pair<int, int> int_pair_t;
 
-  void AddRange(int id, int_pair_t r1, int_pair_t r2);
-  bool FindRange(int episode_number, int_pair_t& result) const;
+  void AddRange(int source_id, int id, int_pair_t r0, int_pair_t r1);
+  void Clear();
+  bool Contains(int source_id) const;
+  bool Empty() const;
+  bool FindRange(int source_id, int episode_number, int_pair_t& result) const;
+  void Sort();
 
 private:
   struct Range {
+    int source_id;
     int id;
     int_pair_t r0;
     int_pair_t r1;
+    size_t order;
+    int max_last_episode;
   };
 
   std::vector<Range> ranges_;
 };
 
-std::map<int, Relation> relations;
+RelationTable relations;
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void Relation::AddRange(int id, int_pair_t r1, int_pair_t r2) {
-  ranges_.push_back({id, r1, r2});
-}
-
-bool Relation::FindRange(int episode_number, int_pair_t& result) const {
-  for (const auto& it : ranges_) {
-    int distance = episode_number - it.r0.first;
-    if (distance >= 0) {
-      if (it.r0.second - episode_number >= 0) {
-        int destination = it.r1.first;
-        if (it.r1.first != it.r1.second)
-          destination += distance;
-        if (destination <= it.r1.second) {
-          result.first = it.id;
-          result.second = destination;
-          return true;
-        }
-      }
+void RelationTable::AddRange(int source_id, int id, int_pair_t r0,
+                             int_pair_t r1) {
+  Range range = {source_id, id, r0, r1, ranges_.size(), r0.second};
+  ranges_.push_back(range);
+}
+
+void RelationTable::Clear() {
+  ranges_.clear();
+}
+
+bool RelationTable::Contains(int source_id) const {
+  auto it = std::lower_bound(ranges_.begin(), ranges_.end(), source_id,
+      [](const Range& range, int id) {
+        return range.source_id < id;
+      });
+  return it != ranges_.end() && it->source_id == source_id;
+}
+
+bool RelationTable::Empty() const {
+  return ranges_.empty();
+}
+
+// When more than one range contains the episode, the one that was added first
+// is used.
+bool RelationTable::FindRange(int source_id, int episode_number,
+                              int_pair_t& result) const {
+  // Ranges that begin after the episode cannot contain it
+  auto it = std::upper_bound(ranges_.begin(), ranges_.end(),
+      std::make_pair(source_id, episode_number),
+      [](const std::pair<int, int>& value, const Range& range) {
+        return value < std::make_pair(range.source_id, range.r0.first);
+      });
+
+  const Range* match = nullptr;
+
+  while (it != ranges_.begin()) {
+    --it;
+    if (it->source_id != source_id ||
+        it->max_last_episode < episode_number)
+      break;
+    if (it->r0.second < episode_number)
+      continue;
+    if (match && match->order < it->order)
+      continue;
+    int destination = it->r1.first;
+    if (it->r1.first != it->r1.second)
+      destination += episode_number - it->r0.first;
+    if (destination <= it->r1.second) {
+      match = &(*it);
+      result.first = it->id;
+      result.second = destination;
     }
   }
 
-  return false;
+  return match != nullptr;
+}
+
+void RelationTable::Sort() {
+  std::sort(ranges_.begin(), ranges_.end(),
+      [](const Range& a, const Range& b) {
+        if (a.source_id != b.source_id)
+          return a.source_id < b.source_id;
+        if (a.r0.first != b.r0.first)
+          return a.r0.first < b.r0.first;
+        return a.order < b.order;
+      });
+
+  for (size_t i = 0; i < ranges_.size(); ++i) {
+    auto& range = ranges_[i];
+    range.max_last_episode = range.r0.second;
+    if (i > 0 && ranges_[i - 1].source_id == range.source_id)
+      range.max_last_episode = max(range.max_last_episode,
+                                   ranges_[i - 1].max_last_episode);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static bool ParseRule(const std::wstring& rule) {
-  static std::wstring id_pattern = L"(\\d+|[?~])";
-  static std::wstring episode_pattern = L"(\\d+)(?:-(\\d+|\\?))?";
-  static const std::wregex pattern(
-      id_pattern + L"\\|" + id_pattern + L":" + episode_pattern + L" -> " +
-      id_pattern + L"\\|" + id_pattern + L":" + episode_pattern + L"(!)?");
-
-  std::match_results<std::wstring::const_iterator> match_results;
-
-  if (std::regex_match(rule, match_results, pattern)) {
-    auto get_id = [&](size_t first, size_t second) {
-      switch (taiga::GetCurrentServiceId()) {
-        case sync::kMyAnimeList:
-          return ToInt(match_results[first].str());
-        case sync::kHummingbird:
-          return ToInt(match_results[second].str());
-        default:
-          return 0;
-      }
-    };
-
-    auto get_range = [&](size_t first, size_t second) {
-      std::pair<int, int> range;
-      range.first = ToInt(match_results[first].str());
-      if (match_results[second].matched) {
-        if (IsNumericString(match_results[second].str())) {
-          range.second = ToInt(match_results[second].str());
-        } else {
-          range.second = INT_MAX;
-        }
-      } else {
-        range.second = range.first;
-      }
-      return range;
-    };
+// The parser works directly on the UTF-8 document. Each function advances the
+// position only if the input matches.
+
+static bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
 
-    int id0 = get_id(1, 2);
-    if (!id0)
+static bool ParseLiteral(const char*& pos, const char* end,
+                         const char* literal) {
+  const char* p = pos;
+  for (; *literal; ++literal, ++p)
+    if (p == end || *p != *literal)
       return false;
-    auto r0 = get_range(3, 4);
+  pos = p;
+  return true;
+}
 
-    int id1 = get_id(5, 6);
-    if (!id1)
-      id1 = id0;
-    auto r1 = get_range(7, 8);
+static bool ParseNumber(const char*& pos, const char* end, int& value) {
+  if (pos == end || !IsDigit(*pos))
+    return false;
 
-    relations[id0].AddRange(id1, r0, r1);
+  value = 0;
+  for (; pos != end && IsDigit(*pos); ++pos) {
+    const int digit = *pos - '0';
+    value = value > (INT_MAX - digit) / 10 ? INT_MAX : value * 10 + digit;
+  }
+  return true;
+}
 
-    if (match_results[9].matched)
-      relations[id1].AddRange(id1, r0, r1);
+// Returns the ID for the current service, or 0 for unknown (?) and same (~)
+static bool ParseIds(const char*& pos, const char* end, int& id) {
+  auto parse_id = [&](int& value) {
+    if (pos != end && (*pos == '?' || *pos == '~')) {
+      value = 0;
+      ++pos;
+      return true;
+    }
+    return ParseNumber(pos, end, value);
+  };
+
+  int ids[2] = {0, 0};
+  if (!parse_id(ids[0]) || !ParseLiteral(pos, end, "|") || !parse_id(ids[1]))
+    return false;
 
-    return true;
+  switch (taiga::GetCurrentServiceId()) {
+    case sync::kMyAnimeList:
+      id = ids[0];
+      break;
+    case sync::kHummingbird:
+      id = ids[1];
+      break;
+    default:
+      id = 0;
+      break;
   }
+  return true;
+}
+
+static bool ParseEpisodeRange(const char*& pos, const char* end,
+                              std::pair<int, int>& range) {
+  if (!ParseNumber(pos, end, range.first))
+    return false;
+
+  range.second = range.first;
+  if (ParseLiteral(pos, end, "-")) {
+    if (ParseLiteral(pos, end, "?")) {
+      range.second = INT_MAX;
+    } else if (!ParseNumber(pos, end, range.second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Rules are in the form of "id|id:episodes -> id|id:episodes!", where the
+// trailing exclamation mark means that the destination redirects to itself.
+static bool ParseRule(const char* pos, const char* end) {
+  int id0 = 0, id1 = 0;
+  std::pair<int, int> r0, r1;
+
+  if (!ParseIds(pos, end, id0) ||
+      !ParseLiteral(pos, end, ":") ||
+      !ParseEpisodeRange(pos, end, r0) ||
+      !ParseLiteral(pos, end, " -> ") ||
+      !ParseIds(pos, end, id1) ||
+      !ParseLiteral(pos, end, ":") ||
+      !ParseEpisodeRange(pos, end, r1))
+    return false;
+
+  const bool redirect_to_self = ParseLiteral(pos, end, "!");
+  if (pos != end)
+    return false;
+
+  if (!id0)
+    return false;
+  if (!id1)
+    id1 = id0;
+
+  relations.AddRange(id0, id1, r0, r1);
 
-  return false;
+  if (redirect_to_self)
+    relations.AddRange(id1, id1, r0, r1);
+
+  return true;
 }
 
 bool Engine::ReadRelations() {
@@ -148,10 +261,8 @@ bool Engine::ReadRelations() {
 }
 
 bool Engine::ReadRelations(const std::string& document) {
-  relations.clear();
-
-  std::vector<std::wstring> lines;
-  Split(StrToWstr(document), L"\n", lines);
+  relations.Clear();
+  ClearCache();  // Episode redirections might have changed
 
   enum FileSections {
     kUnknownSection,
@@ -160,19 +271,33 @@ bool Engine::ReadRelations(const std::string& document) {
   };
   auto current_section = kUnknownSection;
 
-  for (auto& line : lines) {
-    Trim(line, L"\r ");
+  auto is_trimmed = [](char c) { return c == '\r' || c == ' '; };
+  auto is_bullet = [](char c) { return c == '-' || c == ' '; };
+
+  const char* const document_end = document.data() + document.size();
+
+  for (const char* line_end = document.data(); line_end != document_end; ) {
+    const char* begin = line_end;
+    line_end = std::find(begin, document_end, '\n');
+    const char* end = line_end;
+    if (line_end != document_end)
+      ++line_end;
+
+    while (begin != end && is_trimmed(*begin))
+      ++begin;
+    while (begin != end && is_trimmed(*(end - 1)))
+      --end;
 
-    if (line.empty())
+    if (begin == end)
       continue;
-    if (line.front() == L'#')  // comment
+    if (*begin == '#')  // comment
       continue;
 
-    if (StartsWith(line, L"::")) {
-      auto section = line.substr(2);
-      if (section == L"meta") {
+    if (ParseLiteral(begin, end, "::")) {
+      const std::string section(begin, end);
+      if (section == "meta") {
         current_section = kMetaSection;
-      } else if (section == L"rules") {
+      } else if (section == "rules") {
         current_section = kRulesSection;
       } else {
         current_section = kUnknownSection;
@@ -182,55 +307,61 @@ bool Engine::ReadRelations(const std::string& document) {
 
     switch (current_section) {
       case kMetaSection: {
-        TrimLeft(line, L"- ");
-        static const std::wregex pattern(L"([a-z_]+): (.+)");
-        std::match_results<std::wstring::const_iterator> match_results;
-        if (std::regex_match(line, match_results, pattern)) {
-          auto name = match_results[1].str();
-          auto value = match_results[2].str();
-          if (name == L"version") {
+        while (begin != end && is_bullet(*begin))
+          ++begin;
+        // Entries are in the form of "name: value"
+        const char* pos = begin;
+        while (pos != end && ((*pos >= 'a' && *pos <= 'z') || *pos == '_'))
+          ++pos;
+        const char* name_end = pos;
+        if (name_end != begin && ParseLiteral(pos, end, ": ") && pos != end) {
+          const std::string name(begin, name_end);
+          const std::wstring value = StrToWstr(std::string(pos, end));
+          if (name == "version") {
             base::SemanticVersion version(value);
             if (version > Taiga.version)
               LOG(LevelDebug, L"Anime relations version is larger than "
                               L"application version.");
-          } else if (name == L"last_modified") {
+          } else if (name == "last_modified") {
             Settings.Set(taiga::kRecognition_RelationsLastModified, value);
           }
         }
         break;
       }
       case kRulesSection: {
-        TrimLeft(line, L"- ");
-        if (!ParseRule(line))
-          LOG(LevelWarning, L"Could not parse rule: " + line);
+        while (begin != end && is_bullet(*begin))
+          ++begin;
+        if (!ParseRule(begin, end))
+          LOG(LevelWarning, L"Could not parse rule: " +
+                            StrToWstr(std::string(begin, end)));
         break;
       }
     }
   }
 
-  return !relations.empty();
+  relations.Sort();
+  UpdateRelationFacts();
+
+  return !relations.Empty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+bool Engine::HasRelations(int anime_id) const {
+  return relations.Contains(anime_id);
+}
+
 bool Engine::SearchEpisodeRedirection(
     int id, const std::pair<int, int>& range,
     int& destination_id, std::pair<int, int>& destination_range) const {
 
-  auto it = relations.find(id);
-
-  if (it == relations.end())
-    return false;
-
-  const auto& relation = it->second;
-
   std::pair<std::pair<int, int>, std::pair<int, int>> results;
 
-  if (!relation.FindRange(range.first, results.first))
+  if (!relations.FindRange(id, range.first, results.first))
     return false;
 
   if (range.first != range.second) {
-    if (!relation.FindRange(range.second, results.second))
+    if (!relations.FindRange(id, range.second, results.second))
       return false;
     if (results.first.first != results.second.first)
       return false;
@@ -17,7 +17,9 @@
 */
 
 #include <algorithm>
+#include <utility>
 
+#include "base/metrics.h"
 #include "base/string.h"
 #include "library/anime_db.h"
 #include "library/anime_episode.h"
@@ -27,12 +29,52 @@
 namespace track {
 namespace recognition {
 
+static base::Metric score_metric(
+    L"Recognition/ScoreTitle", base::Metric::kDuration);
+static base::Metric score_candidates_metric(
+    L"Recognition/ScoreTitle/Candidates", base::Metric::kValue);
+static base::Metric score_compared_metric(
+    L"Recognition/ScoreTitle/Compared", base::Metric::kValue);
+
+IdentifyResult::IdentifyResult()
+    : anime_id_(anime::ID_UNKNOWN) {
+}
+
+IdentifyResult::IdentifyResult(IdentifyResult&& result)
+    : anime_id_(result.anime_id_),
+      candidates_(std::move(result.candidates_)) {
+}
+
+IdentifyResult& IdentifyResult::operator=(IdentifyResult&& result) {
+  anime_id_ = result.anime_id_;
+  candidates_ = std::move(result.candidates_);
+  return *this;
+}
+
+int IdentifyResult::anime_id() const {
+  return anime_id_;
+}
+
+const candidates_t& IdentifyResult::candidates() const {
+  return candidates_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 sorted_scores_t Engine::GetScores() const {
   return scores_;
 }
 
+void Engine::SetScores(const candidates_t& candidates) {
+  scores_.clear();
+  for (const auto& candidate : candidates)
+    scores_.push_back(std::make_pair(candidate.anime_id, candidate.score));
+}
+
 int Engine::ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids,
-                       const MatchOptions& match_options) {
+                       const MatchOptions& match_options,
+                       candidates_t& candidates,
+                       size_t max_candidates) const {
   scores_t trigram_results;
 
   auto normal_title = episode.anime_title();
@@ -42,7 +84,10 @@ int Engine::ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids,
   GetTrigrams(normal_title, t1);
 
   auto calculate_trigram_results = [&](int anime_id) {
-    for (const auto& t2 : db_[anime_id].trigrams) {
+    auto it = db_.find(anime_id);
+    if (it == db_.end())
+      return;
+    for (const auto& t2 : it->second.trigrams) {
       double result = CompareTrigrams(t1, t2);
       if (result > 0.1) {
         auto& target = trigram_results[anime_id];
@@ -56,16 +101,93 @@ int Engine::ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids,
       calculate_trigram_results(id);
     }
   } else {
-    for (const auto& it : AnimeDatabase.items) {
-      if (ValidateOptions(episode, it.second, match_options, false))
-        calculate_trigram_results(it.first);
+    // Only the titles that share at least one trigram with the query can pass
+    // the threshold, so we don't need to visit the rest of the database.
+    SearchTrigramIndex(t1, trigram_results);
+    FilterCandidates(episode, match_options, trigram_results);
+  }
+
+  return ScoreTitle(normal_title, episode, trigram_results, candidates,
+                    max_candidates);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Engine::AddToTrigramIndex(int anime_id) {
+  auto it = db_.find(anime_id);
+  if (it == db_.end())
+    return;
+
+  const auto& trigrams = it->second.trigrams;
+
+  for (size_t i = 0; i < trigrams.size(); ++i) {
+    for (const auto& trigram : trigrams[i]) {
+      TrigramPosting posting = {anime_id, static_cast<int>(i)};
+      trigram_index_[trigram].push_back(posting);
+    }
+  }
+}
+
+void Engine::RemoveFromTrigramIndex(int anime_id) {
+  auto it = db_.find(anime_id);
+  if (it == db_.end())
+    return;
+
+  auto has_same_id = [&anime_id](const TrigramPosting& posting) {
+    return posting.anime_id == anime_id;
+  };
+
+  for (const auto& trigrams : it->second.trigrams) {
+    for (const auto& trigram : trigrams) {
+      auto postings = trigram_index_.find(trigram);
+      if (postings == trigram_index_.end())
+        continue;
+      auto& container = postings->second;
+      container.erase(std::remove_if(container.begin(), container.end(),
+                                     has_same_id),
+                      container.end());
+      if (container.empty())
+        trigram_index_.erase(postings);
+    }
+  }
+}
+
+void Engine::SearchTrigramIndex(const trigram_container_t& trigrams,
+                                scores_t& results) const {
+  // Number of common trigrams for each (anime_id, title_index) pair
+  std::map<std::pair<int, int>, int> intersections;
+
+  // Repeated trigrams are tagged to be unique, so each posting counts once
+  for (const auto& trigram : trigrams) {
+    auto postings = trigram_index_.find(trigram);
+    if (postings != trigram_index_.end()) {
+      for (const auto& posting : postings->second) {
+        auto key = std::make_pair(posting.anime_id, posting.title_index);
+        intersections[key] += 1;
+      }
     }
   }
 
-  return ScoreTitle(normal_title, episode, trigram_results);
+  // Same result as CompareTrigrams, without having to visit each title
+  for (const auto& intersection : intersections) {
+    int anime_id = intersection.first.first;
+    size_t title_index = intersection.first.second;
+    auto it = db_.find(anime_id);
+    if (it == db_.end() || title_index >= it->second.trigrams.size())
+      continue;
+    const auto& t2 = it->second.trigrams.at(title_index);
+    double result = static_cast<double>(intersection.second) /
+                    static_cast<double>(max(trigrams.size(), t2.size()));
+    if (result > 0.1) {
+      auto& target = results[anime_id];
+      target = max(target, result);
+    }
+  }
 }
 
-static double CustomScore(const std::wstring& title, const std::wstring& str) {
+static double CustomScore(const std::wstring& title,
+                          const StringPattern& pattern) {
+  const auto& str = pattern.str();
   double length_min = min(title.size(), str.size());
   double length_max = max(title.size(), str.size());
   double length_ratio = length_min / length_max;
@@ -77,7 +199,7 @@ static double CustomScore(const std::wstring& title, const std::wstring& str) {
   } else if (InStr(title, str) > -1 || InStr(str, title) > -1) {
     score = length_ratio * 0.9;
   } else {
-    auto length_lcs = LongestCommonSubsequenceLength(title, str);
+    auto length_lcs = LongestCommonSubsequenceLength(title, pattern);
     auto lcs_score = length_lcs / length_max;
     score = lcs_score * 0.8;
 
@@ -111,49 +233,148 @@ static double BonusScore(const anime::Episode& episode, int id) {
   return score;
 };
 
+static double CalculateScore(double jaro_winkler, double custom,
+                             double levenshtein, double trigram, double bonus) {
+  return (((1.0 * jaro_winkler) +
+           (0.5 * std::pow(custom, 0.66)) +
+           (0.3 * std::pow(levenshtein, 0.8)) +
+           (0.2 * std::pow(trigram, 0.8))) / 2.0) + bonus;
+}
+
+// Upper bounds of the individual scores, which only depend on string lengths.
+// They let us skip candidates that cannot make it into the results.
+static void CalculateScoreBounds(size_t length1, size_t length2,
+                                 double& jaro_winkler, double& custom,
+                                 double& levenshtein) {
+  const size_t length_min = min(length1, length2);
+  const size_t length_max = max(length1, length2);
+
+  if (length_min == 0) {
+    jaro_winkler = custom = levenshtein = 0.0;
+    return;
+  }
+
+  const double length_ratio = static_cast<double>(length_min) / length_max;
+
+  // Edit distance is at least the difference in length
+  levenshtein = length_ratio;
+
+  // Either the strings have a common prefix or substring, or the score is
+  // based on the LCS or a common prefix that is shorter than both strings
+  custom = max(length_ratio,
+               0.7 * static_cast<double>(length_min - 1) / length_min);
+
+  // At most length_min characters can match, without any transpositions
+  double jaro = (length_ratio + 1.0 + 1.0) / 3.0;
+  const double prefix_length = static_cast<double>(min(length_min, static_cast<size_t>(4)));
+  jaro_winkler = jaro + (prefix_length * 0.1 * (1.0 - jaro));
+}
+
 int Engine::ScoreTitle(const std::wstring& str, const anime::Episode& episode,
-                       const scores_t& trigram_results) {
-  scores_t jaro_winkler, levenshtein, custom, bonus;
+                       const scores_t& trigram_results,
+                       candidates_t& candidates,
+                       size_t max_candidates) const {
+  base::ScopedTimer timer(score_metric);
+  score_candidates_metric.Add(trigram_results.size());
+  LONGLONG compared = 0;
 
-  scores_.clear();
+  const double min_score = 0.3;
+  // Tolerance for rounding errors when comparing upper bounds
+  const double epsilon = 1e-9;
+
+  // Orders by descending score, then by ascending ID
+  auto is_better = [](const Candidate& a, const Candidate& b) {
+    return a.score > b.score ||
+           (a.score == b.score && a.anime_id < b.anime_id);
+  };
+
+  // A heap of the best results so far, with the worst one at the front. We
+  // need at least two results to tell whether the first one is ambiguous.
+  const size_t heap_size = max(max_candidates, static_cast<size_t>(2));
+  candidates.clear();
+
+  // Character masks of the string are shared between all comparisons
+  const StringPattern pattern(str);
 
   for (const auto& trigram_result : trigram_results) {
     int id = trigram_result.first;
+    auto it = db_.find(id);
+    if (it == db_.end())
+      continue;
+
+    const auto& normal_titles = it->second.normal_titles;
+    const double bonus = BonusScore(episode, id);
+
+    // Skip the expensive calculations if the candidate has no chance
+    double jaro_winkler = 0.0, custom = 0.0, levenshtein = 0.0;
+    for (const auto& title : normal_titles) {
+      double jaro_winkler_bound, custom_bound, levenshtein_bound;
+      CalculateScoreBounds(title.size(), str.size(), jaro_winkler_bound,
+                           custom_bound, levenshtein_bound);
+      jaro_winkler = max(jaro_winkler, jaro_winkler_bound);
+      custom = max(custom, custom_bound);
+      levenshtein = max(levenshtein, levenshtein_bound);
+    }
+    const double score_bound = CalculateScore(jaro_winkler, custom, levenshtein,
+                                              trigram_result.second, bonus) +
+                               epsilon;
+    if (score_bound < min_score)
+      continue;
+    if (candidates.size() == heap_size) {
+      Candidate bound = {id, score_bound};
+      if (!is_better(bound, candidates.front()))
+        continue;
+    }
 
     // Calculate individual scores for all titles
-    for (auto& title : db_[id].normal_titles) {
-      jaro_winkler[id] = max(jaro_winkler[id], JaroWinklerDistance(title, str));
-      levenshtein[id] = max(levenshtein[id], LevenshteinDistance(title, str));
-      custom[id] = max(custom[id], CustomScore(title, str));
+    ++compared;
+    jaro_winkler = custom = levenshtein = 0.0;
+    for (const auto& title : normal_titles) {
+      jaro_winkler = max(jaro_winkler, JaroWinklerDistance(title, pattern));
+      levenshtein = max(levenshtein, LevenshteinDistance(title, pattern));
+      custom = max(custom, CustomScore(title, pattern));
     }
-    bonus[id] = BonusScore(episode, id);
 
     // Calculate the average score for the ID
-    double score =
-        (((1.0 * jaro_winkler[id]) +
-          (0.5 * std::pow(custom[id], 0.66)) +
-          (0.3 * std::pow(levenshtein[id], 0.8)) +
-          (0.2 * std::pow(trigram_result.second, 0.8))) / 2.0) + bonus[id];
-    if (score >= 0.3)
-      scores_.push_back(std::make_pair(id, score));
+    const Candidate result = {
+      id,
+      CalculateScore(jaro_winkler, custom, levenshtein,
+                     trigram_result.second, bonus),
+      jaro_winkler,
+      levenshtein,
+      custom,
+      trigram_result.second,
+      bonus
+    };
+    if (result.score < min_score)
+      continue;
+
+    if (candidates.size() < heap_size) {
+      candidates.push_back(result);
+      std::push_heap(candidates.begin(), candidates.end(), is_better);
+    } else if (is_better(result, candidates.front())) {
+      std::pop_heap(candidates.begin(), candidates.end(), is_better);
+      candidates.back() = result;
+      std::push_heap(candidates.begin(), candidates.end(), is_better);
+    }
   }
 
-  // Sort scores in descending order, then limit the results
-  std::stable_sort(scores_.begin(), scores_.end(),
-      [&](const std::pair<int, double>& a,
-          const std::pair<int, double>& b) {
-        return a.second > b.second;
-      });
-  if (scores_.size() > 20)
-    scores_.resize(20);
+  score_compared_metric.Add(compared);
+
+  // Sort scores in descending order
+  std::sort(candidates.begin(), candidates.end(), is_better);
 
-  double score_1st = scores_.size() > 0 ? scores_.at(0).second : 0.0;
-  double score_2nd = scores_.size() > 1 ? scores_.at(1).second : 0.0;
+  double score_1st = candidates.size() > 0 ? candidates.at(0).score : 0.0;
+  double score_2nd = candidates.size() > 1 ? candidates.at(1).score : 0.0;
 
+  int anime_id = anime::ID_UNKNOWN;
   if (score_1st >= 1.0 && score_1st != score_2nd)
-    return scores_.front().first;
+    anime_id = candidates.front().anime_id;
+
+  if (candidates.size() > max_candidates)
+    candidates.resize(max_candidates);
 
-  return anime::ID_UNKNOWN;
+  return anime_id;
 }
 
 }  // namespace recognition
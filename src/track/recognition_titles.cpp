@@ -0,0 +1,157 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cwchar>
+
+#include "track/recognition.h"
+
+namespace track {
+namespace recognition {
+
+TitleTable::TitleTable() {
+  Clear();
+}
+
+void TitleTable::Clear() {
+  buffer_.clear();
+  keys_.clear();
+  slots_.assign(64, 0);
+  key_indexes_.clear();
+}
+
+void TitleTable::Erase(int anime_id) {
+  auto it = key_indexes_.find(anime_id);
+  if (it == key_indexes_.end())
+    return;
+
+  for (const auto key_index : it->second) {
+    auto& key = keys_.at(key_index);
+    int* ids_end = key.ids + key.inline_id_count();
+    int* id = std::find(key.ids, ids_end, anime_id);
+    if (id != ids_end) {
+      // Fill the gap with the last ID
+      if (!key.more_ids.empty()) {
+        *id = key.more_ids.back();
+        key.more_ids.pop_back();
+      } else {
+        *id = *(ids_end - 1);
+      }
+    } else {
+      key.more_ids.erase(std::find(key.more_ids.begin(), key.more_ids.end(),
+                                   anime_id));
+    }
+    --key.id_count;
+  }
+
+  key_indexes_.erase(it);
+}
+
+bool TitleTable::Find(const std::wstring& title,
+                      std::set<int>& anime_ids) const {
+  const unsigned int key_index = slots_.at(FindSlot(title, Hash(title)));
+  if (!key_index)
+    return false;
+
+  const auto& key = keys_.at(key_index - 1);
+  anime_ids.insert(key.ids, key.ids + key.inline_id_count());
+  anime_ids.insert(key.more_ids.begin(), key.more_ids.end());
+  return true;
+}
+
+void TitleTable::Insert(const std::wstring& title, int anime_id) {
+  const unsigned int hash = Hash(title);
+  size_t slot = FindSlot(title, hash);
+
+  if (!slots_.at(slot)) {
+    // Keep the load factor under 1/2
+    if ((keys_.size() + 1) * 2 > slots_.size()) {
+      Rehash(slots_.size() * 2);
+      slot = FindSlot(title, hash);
+    }
+    Key key;
+    key.offset = buffer_.size();
+    key.length = title.size();
+    key.hash = hash;
+    key.id_count = 0;
+    buffer_.insert(buffer_.end(), title.begin(), title.end());
+    keys_.push_back(key);
+    slots_.at(slot) = static_cast<unsigned int>(keys_.size());
+  }
+
+  const unsigned int key_index = slots_.at(slot) - 1;
+  auto& key = keys_.at(key_index);
+
+  int* ids_end = key.ids + key.inline_id_count();
+  if (std::find(key.ids, ids_end, anime_id) != ids_end ||
+      std::find(key.more_ids.begin(), key.more_ids.end(),
+                anime_id) != key.more_ids.end())
+    return;
+
+  if (key.id_count < kInlineIds) {
+    key.ids[key.id_count] = anime_id;
+  } else {
+    key.more_ids.push_back(anime_id);
+  }
+  ++key.id_count;
+
+  key_indexes_[anime_id].push_back(key_index);
+}
+
+// FNV-1a
+unsigned int TitleTable::Hash(const std::wstring& title) {
+  unsigned int hash = 2166136261u;
+  for (const auto c : title) {
+    hash ^= static_cast<unsigned int>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Returns the slot that holds the title, or the empty slot where it would be
+// inserted.
+size_t TitleTable::FindSlot(const std::wstring& title,
+                            unsigned int hash) const {
+  const size_t mask = slots_.size() - 1;
+
+  for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+    const unsigned int key_index = slots_[slot];
+    if (!key_index)
+      return slot;
+    const auto& key = keys_[key_index - 1];
+    if (key.hash == hash && key.length == title.size() &&
+        (key.length == 0 ||
+         wmemcmp(&buffer_[key.offset], title.data(), key.length) == 0))
+      return slot;
+  }
+}
+
+void TitleTable::Rehash(size_t slot_count) {
+  slots_.assign(slot_count, 0);
+  const size_t mask = slot_count - 1;
+
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    size_t slot = keys_[i].hash & mask;
+    while (slots_[slot])
+      slot = (slot + 1) & mask;
+    slots_[slot] = static_cast<unsigned int>(i + 1);
+  }
+}
+
+}  // namespace recognition
+}  // namespace track
\ No newline at end of file
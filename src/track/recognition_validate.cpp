@@ -16,10 +16,16 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <climits>
+#include <emmintrin.h>
+
 #include <anitomy/anitomy/keyword.h>
 
 #include "base/log.h"
+#include "base/metrics.h"
 #include "base/string.h"
+#include "base/time.h"
 #include "library/anime.h"
 #include "library/anime_db.h"
 #include "library/anime_episode.h"
@@ -29,6 +35,12 @@
 namespace track {
 namespace recognition {
 
+// Counted rather than timed, as this is called for every candidate
+static base::Metric validate_metric(
+    L"Recognition/ValidateOptions", base::Metric::kCount);
+static base::Metric filter_metric(
+    L"Recognition/FilterCandidates", base::Metric::kDuration);
+
 bool Engine::ValidateOptions(anime::Episode& episode, int anime_id,
                              const MatchOptions& match_options,
                              bool redirect) const {
@@ -44,6 +56,8 @@ bool Engine::ValidateOptions(anime::Episode& episode,
                              const anime::Item& anime_item,
                              const MatchOptions& match_options,
                              bool redirect) const {
+  validate_metric.Add();
+
   if (match_options.check_airing_date)
     if (!anime::IsAiredYet(anime_item))
       return false;
@@ -101,6 +115,231 @@ bool Engine::ValidateEpisodeNumber(anime::Episode& episode,
   return false;  // Episode number is out of range
 }
 
+// Validates the facts of four candidates at once, and returns a mask of the
+// ones that pass. Candidates that fail only because of their episode number
+// are returned in a separate mask, as they might still be redirected.
+static int ValidateFacts(const int* airing_dates, const int* episode_counts,
+                         __m128i date_japan, __m128i episode_number,
+                         bool check_airing_date, bool check_episode_number,
+                         __m128i episode_valid, bool check_single_episode,
+                         bool check_episode_range, int& redirect_mask) {
+  const __m128i ones = _mm_set1_epi32(-1);
+  __m128i aired = ones;
+  __m128i episode = ones;
+
+  if (check_airing_date) {
+    __m128i dates = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(airing_dates));
+    aired = _mm_xor_si128(_mm_cmpgt_epi32(dates, date_japan), ones);
+  }
+
+  if (check_episode_number) {
+    __m128i counts = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(episode_counts));
+    episode = episode_valid;
+    if (check_single_episode)
+      episode = _mm_or_si128(episode,
+          _mm_cmpeq_epi32(counts, _mm_set1_epi32(1)));
+    if (check_episode_range)
+      episode = _mm_or_si128(episode,
+          _mm_xor_si128(_mm_cmpgt_epi32(episode_number, counts), ones));
+    // Episode count is unknown, so anything goes
+    episode = _mm_or_si128(episode,
+        _mm_or_si128(_mm_cmpgt_epi32(_mm_set1_epi32(1), counts),
+                     _mm_cmpgt_epi32(counts, _mm_set1_epi32(1899))));
+  }
+
+  int aired_mask = _mm_movemask_ps(_mm_castsi128_ps(aired));
+  int episode_mask = _mm_movemask_ps(_mm_castsi128_ps(episode));
+
+  redirect_mask = aired_mask & ~episode_mask;
+  return aired_mask & episode_mask;
+}
+
+// Does the same as calling ValidateOptions for each candidate without
+// redirection, but checks the episode-specific conditions only once and the
+// facts of four candidates at a time.
+void Engine::FilterCandidates(anime::Episode& episode,
+                              const MatchOptions& match_options,
+                              scores_t& candidates) const {
+  base::ScopedTimer timer(filter_metric);
+
+  if (candidates.empty())
+    return;
+  if (!match_options.check_airing_date &&
+      !match_options.check_anime_type &&
+      !match_options.check_episode_number)
+    return;
+
+  if (match_options.check_anime_type && !IsValidAnimeType(episode)) {
+    candidates.clear();
+    return;
+  }
+
+  // Gather the facts of each candidate. Both containers are sorted by anime
+  // ID, so a single pass is enough.
+  std::vector<int> indexes;
+  std::vector<int> airing_dates;
+  std::vector<int> episode_counts;
+  indexes.reserve(candidates.size());
+  airing_dates.reserve(candidates.size() + 3);
+  episode_counts.reserve(candidates.size() + 3);
+
+  auto fact = facts_.anime_ids.begin();
+  for (const auto& candidate : candidates) {
+    fact = std::lower_bound(fact, facts_.anime_ids.end(), candidate.first);
+    if (fact != facts_.anime_ids.end() && *fact == candidate.first) {
+      size_t index = fact - facts_.anime_ids.begin();
+      indexes.push_back(static_cast<int>(index));
+      airing_dates.push_back(facts_.airing_dates.at(index));
+      episode_counts.push_back(facts_.episode_counts.at(index));
+    } else {
+      indexes.push_back(-1);
+      airing_dates.push_back(0);
+      episode_counts.push_back(0);
+    }
+  }
+  while (airing_dates.size() % 4) {
+    airing_dates.push_back(0);
+    episode_counts.push_back(0);
+  }
+
+  const Date date_japan = GetDateJapan();
+  const int packed_date_japan = date_japan.year * 10000 +
+                                date_japan.month * 100 + date_japan.day;
+
+  const bool no_episode_number =
+      episode.elements().empty(anitomy::kElementEpisodeNumber);
+  const bool batch_release =
+      no_episode_number && episode.file_extension().empty();
+  const auto range = episode.episode_number_range();
+
+  const __m128i date_japan_v = _mm_set1_epi32(packed_date_japan);
+  const __m128i episode_number_v = _mm_set1_epi32(range.second);
+  const __m128i episode_valid_v = _mm_set1_epi32(batch_release ? -1 : 0);
+
+  std::vector<char> results(airing_dates.size());
+  for (size_t i = 0; i < airing_dates.size(); i += 4) {
+    int redirect_mask = 0;
+    int mask = ValidateFacts(&airing_dates.at(i), &episode_counts.at(i),
+                             date_japan_v, episode_number_v,
+                             match_options.check_airing_date,
+                             match_options.check_episode_number,
+                             episode_valid_v, no_episode_number,
+                             range.second > 0, redirect_mask);
+    for (size_t j = 0; j < 4; ++j) {
+      if (mask & (1 << j)) {
+        results.at(i + j) = true;
+      } else if ((redirect_mask & (1 << j)) && match_options.allow_sequels &&
+                 i + j < indexes.size() && indexes.at(i + j) > -1 &&
+                 facts_.has_relations.at(indexes.at(i + j))) {
+        int destination_id = anime::ID_UNKNOWN;
+        std::pair<int, int> destination_range;
+        results.at(i + j) = SearchEpisodeRedirection(
+            facts_.anime_ids.at(indexes.at(i + j)), range,
+            destination_id, destination_range);
+      }
+    }
+  }
+
+  size_t i = 0;
+  for (auto it = candidates.begin(); it != candidates.end(); ++i) {
+    bool valid = indexes.at(i) > -1 ?
+        results.at(i) != 0 :
+        ValidateOptions(episode, it->first, match_options, false);
+    if (!valid) {
+      it = candidates.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Engine::BuildFacts() {
+  facts_.anime_ids.clear();
+  facts_.airing_dates.clear();
+  facts_.episode_counts.clear();
+  facts_.has_relations.clear();
+
+  for (const auto& it : AnimeDatabase.items) {
+    if (!anime::IsValidId(it.first))
+      continue;
+    facts_.anime_ids.push_back(it.first);
+    facts_.airing_dates.push_back(0);
+    facts_.episode_counts.push_back(0);
+    facts_.has_relations.push_back(false);
+    SetFacts(facts_.anime_ids.size() - 1, it.second);
+  }
+}
+
+void Engine::SetFacts(size_t index, const anime::Item& anime_item) {
+  // Same as anime::IsAiredYet, except that the date is compared later on
+  int airing_date = 0;
+  if (anime_item.GetAiringStatus(false) == anime::kNotYetAired) {
+    Date date_start = anime_item.GetDateStart();
+    if (anime::IsValidDate(date_start)) {
+      // Assume the worst case
+      if (!date_start.month)
+        date_start.month = 12;
+      if (!date_start.day)
+        date_start.day = 31;
+      airing_date = date_start.year * 10000 +
+                    date_start.month * 100 + date_start.day;
+    } else {
+      airing_date = INT_MAX;
+    }
+  }
+
+  facts_.airing_dates.at(index) = airing_date;
+  facts_.episode_counts.at(index) = anime_item.GetEpisodeCount();
+  facts_.has_relations.at(index) = HasRelations(facts_.anime_ids.at(index));
+}
+
+void Engine::UpdateFacts(int anime_id) {
+  if (!titles_initialized_)
+    return;  // Facts are built along with the titles
+  if (title_update_depth_ > 0) {
+    facts_outdated_ = true;  // Rebuilt in CommitTitleUpdate
+    return;
+  }
+
+  // Cached results were validated against the previous facts
+  InvalidateCache(anime_id, std::set<std::wstring>());
+
+  auto it = std::lower_bound(facts_.anime_ids.begin(), facts_.anime_ids.end(),
+                             anime_id);
+  const size_t index = it - facts_.anime_ids.begin();
+  const bool found = it != facts_.anime_ids.end() && *it == anime_id;
+
+  auto anime_item = AnimeDatabase.FindItem(anime_id, false);
+
+  if (!anime_item) {
+    if (found) {
+      facts_.anime_ids.erase(facts_.anime_ids.begin() + index);
+      facts_.airing_dates.erase(facts_.airing_dates.begin() + index);
+      facts_.episode_counts.erase(facts_.episode_counts.begin() + index);
+      facts_.has_relations.erase(facts_.has_relations.begin() + index);
+    }
+    return;
+  }
+
+  if (!found) {
+    facts_.anime_ids.insert(facts_.anime_ids.begin() + index, anime_id);
+    facts_.airing_dates.insert(facts_.airing_dates.begin() + index, 0);
+    facts_.episode_counts.insert(facts_.episode_counts.begin() + index, 0);
+    facts_.has_relations.insert(facts_.has_relations.begin() + index, false);
+  }
+
+  SetFacts(index, *anime_item);
+}
+
+void Engine::UpdateRelationFacts() {
+  for (size_t i = 0; i < facts_.anime_ids.size(); ++i)
+    facts_.has_relations.at(i) = HasRelations(facts_.anime_ids.at(i));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 static bool ValidateAnitomyElement(std::wstring str,
@@ -43,18 +43,16 @@ bool TaigaFileSearchHelper::OnDirectory(const std::wstring& root,
   parse_options.parse_path = false;
   parse_options.streaming_media = false;
 
-  if (!Meow.Parse(name, parse_options, episode_)) {
-    LOG(LevelDebug, L"Could not parse directory: " + name);
-    return false;
-  }
-
   static track::recognition::MatchOptions match_options;
   match_options.allow_sequels = false;
   match_options.check_airing_date = false;
   match_options.check_anime_type = false;
   match_options.check_episode_number = false;
 
-  Meow.Identify(episode_, false, match_options);
+  if (!Meow.Recognize(name, parse_options, match_options, episode_)) {
+    LOG(LevelDebug, L"Could not parse directory: " + name);
+    return false;
+  }
 
   anime::Item* anime_item = AnimeDatabase.FindItem(episode_.anime_id);
 
@@ -81,18 +79,16 @@ bool TaigaFileSearchHelper::OnFile(const std::wstring& root,
   parse_options.parse_path = true;
   parse_options.streaming_media = false;
 
-  if (!Meow.Parse(path, parse_options, episode_)) {
-    LOG(LevelDebug, L"Could not parse filename: " + name);
-    return false;
-  }
-
   static track::recognition::MatchOptions match_options;
   match_options.allow_sequels = true;
   match_options.check_airing_date = true;
   match_options.check_anime_type = true;
   match_options.check_episode_number = true;
 
-  Meow.Identify(episode_, false, match_options);
+  if (!Meow.Recognize(path, parse_options, match_options, episode_)) {
+    LOG(LevelDebug, L"Could not parse filename: " + name);
+    return false;
+  }
 
   anime::Item* anime_item = AnimeDatabase.FindItem(episode_.anime_id);
 
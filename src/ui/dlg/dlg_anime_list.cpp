@@ -1315,26 +1315,28 @@ void AnimeListDialog::RefreshList(int index) {
   std::vector<int> group_count(anime::kMyStatusLast);
   int group_index = -1;
   int i = 0;
-  foreach_(it, AnimeDatabase.items) {
-    anime::Item& anime_item = it->second;
-
-    if (!anime_item.IsInList())
-      continue;
-    if (IsDeletedFromList(anime_item))
+  const auto& columns = AnimeDatabase.columns.Get();
+  for (size_t row = 0; row < columns.anime_ids.size(); ++row) {
+    if (!columns.in_list[row])
       continue;
     if (!group_view) {
-      if (it->second.GetMyRewatching()) {
+      if (columns.my_rewatching[row]) {
         if (current_status_ != anime::kWatching)
           continue;
-      } else if (current_status_ != anime_item.GetMyStatus()) {
+      } else if (current_status_ != columns.my_statuses[row]) {
         continue;
       }
     }
+
+    anime::Item& anime_item = *AnimeDatabase.FindItem(columns.anime_ids[row]);
+
+    if (IsDeletedFromList(anime_item))
+      continue;
     if (!DlgMain.search_bar.filters.CheckItem(anime_item))
       continue;
 
-    group_count.at(anime_item.GetMyStatus())++;
-    group_index = group_view ? anime_item.GetMyStatus() : -1;
+    group_count.at(columns.my_statuses[row])++;
+    group_index = group_view ? columns.my_statuses[row] : -1;
     i = listview.GetItemCount();
 
     listview.InsertItem(i, group_index, -1,
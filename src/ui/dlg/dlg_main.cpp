@@ -216,6 +216,9 @@ void MainDialog::CreateDialogControls() {
   toolbar_main.InsertButton(6, 0, 0, 0, BTNS_SEP, 0, nullptr, nullptr);
   toolbar_main.InsertButton(7, ui::kIcon24_About, kToolbarButtonDebug,
                             fsState, fsStyle1, 7, nullptr, L"Debug");
+  toolbar_main.InsertButton(8, ui::kIcon24_Recognition,
+                            kToolbarButtonDebugRecognition,
+                            fsState, fsStyle1, 8, nullptr, L"Test recognition");
 #endif
 
   // Insert rebar bands
@@ -36,7 +36,8 @@ enum MainToolbarButtons {
   kToolbarButtonFolders = 202,
   kToolbarButtonTools = 203,
   kToolbarButtonSettings = 205,
-  kToolbarButtonDebug = 207
+  kToolbarButtonDebug = 207,
+  kToolbarButtonDebugRecognition = 208
 };
 
 enum SearchMode {
@@ -207,6 +207,9 @@ BOOL MainDialog::OnCommand(WPARAM wParam, LPARAM lParam) {
     case kToolbarButtonDebug:
       debug::Test();
       return TRUE;
+    case kToolbarButtonDebugRecognition:
+      debug::TestRecognition();
+      return TRUE;
   }
 
   // Search text
@@ -135,10 +135,7 @@ int SortListByAiringStatus(const anime::Item& item1, const anime::Item& item2) {
   return CompareValues<int>(item1.GetAiringStatus(), item2.GetAiringStatus());
 }
 
-int SortListByDateStart(const anime::Item& item1, const anime::Item& item2) {
-  Date date1 = item1.GetDateStart();
-  Date date2 = item2.GetDateStart();
-
+int SortListByDateStart(Date date1, Date date2) {
   if (date1 != date2) {
     if (!date1.year)
       date1.year = static_cast<unsigned short>(-1);  // Hello.
@@ -157,19 +154,12 @@ int SortListByDateStart(const anime::Item& item1, const anime::Item& item2) {
   return CompareValues<Date>(date1, date2);
 }
 
-int SortListByEpisodeCount(const anime::Item& item1, const anime::Item& item2) {
-  return CompareValues<int>(item1.GetEpisodeCount(), item2.GetEpisodeCount());
-}
-
 int SortListByLastUpdated(const anime::Item& item1, const anime::Item& item2) {
   return CompareValues<time_t>(_wtoi64(item1.GetMyLastUpdated().c_str()),
                                _wtoi64(item2.GetMyLastUpdated().c_str()));
 }
 
-int SortListByPopularity(const anime::Item& item1, const anime::Item& item2) {
-  int val1 = item1.GetPopularity();
-  int val2 = item2.GetPopularity();
-
+int SortListByPopularity(int val1, int val2) {
   if (val1 != val2)
     if (val1 == 0 || val2 == 0)
       return val2 == 0 ? base::kLessThan : base::kGreaterThan;
@@ -191,14 +181,6 @@ int SortListByProgress(const anime::Item& item1, const anime::Item& item2) {
   }
 }
 
-int SortListByMyScore(const anime::Item& item1, const anime::Item& item2) {
-  return CompareValues<double>(item1.GetMyScore(), item2.GetMyScore());
-}
-
-int SortListByScore(const anime::Item& item1, const anime::Item& item2) {
-  return CompareValues<double>(item1.GetScore(), item2.GetScore());
-}
-
 int SortListByTitle(const anime::Item& item1, const anime::Item& item2) {
   if (Settings.GetBool(taiga::kApp_List_DisplayEnglishTitles)) {
     return CompareStrings(item1.GetEnglishTitle(true),
@@ -242,26 +224,80 @@ int SortList(int type, LPCWSTR str1, LPCWSTR str2) {
   return base::kEqualTo;
 }
 
+// Compares the values that are kept in the column store, without having to
+// look up the items. Returns false if the type is not stored as a column.
+static bool SortListByColumn(int type, int id1, int id2, int& result) {
+  switch (type) {
+    case kListSortDateStart:
+    case kListSortEpisodeCount:
+    case kListSortMyScore:
+    case kListSortPopularity:
+    case kListSortScore:
+      break;
+    default:
+      return false;
+  }
+
+  const auto& columns = AnimeDatabase.columns.Get();
+  const size_t row1 = columns.Find(id1);
+  const size_t row2 = columns.Find(id2);
+
+  if (row1 == columns.npos || row2 == columns.npos)
+    return false;
+
+  switch (type) {
+    case kListSortDateStart:
+      result = SortListByDateStart(columns.date_starts[row1],
+                                   columns.date_starts[row2]);
+      break;
+    case kListSortEpisodeCount:
+      result = CompareValues<int>(columns.episode_counts[row1],
+                                  columns.episode_counts[row2]);
+      break;
+    case kListSortMyScore:
+      result = CompareValues<int>(columns.my_scores[row1],
+                                  columns.my_scores[row2]);
+      break;
+    case kListSortPopularity:
+      result = SortListByPopularity(columns.popularities[row1],
+                                    columns.popularities[row2]);
+      break;
+    case kListSortScore:
+      result = CompareValues<double>(columns.scores[row1],
+                                     columns.scores[row2]);
+      break;
+  }
+
+  return true;
+}
+
 int SortList(int type, int order, int id1, int id2) {
+  int result = base::kEqualTo;
+  if (SortListByColumn(type, id1, id2, result))
+    return result;
+
   auto item1 = AnimeDatabase.FindItem(id1);
   auto item2 = AnimeDatabase.FindItem(id2);
 
   if (item1 && item2) {
     switch (type) {
       case kListSortDateStart:
-        return SortListByDateStart(*item1, *item2);
+        return SortListByDateStart(item1->GetDateStart(),
+                                   item2->GetDateStart());
       case kListSortEpisodeCount:
-        return SortListByEpisodeCount(*item1, *item2);
+        return CompareValues<int>(item1->GetEpisodeCount(),
+                                  item2->GetEpisodeCount());
       case kListSortLastUpdated:
         return SortListByLastUpdated(*item1, *item2);
       case kListSortPopularity:
-        return SortListByPopularity(*item1, *item2);
+        return SortListByPopularity(item1->GetPopularity(),
+                                    item2->GetPopularity());
       case kListSortProgress:
         return SortListByProgress(*item1, *item2);
       case kListSortMyScore:
-        return SortListByMyScore(*item1, *item2);
+        return CompareValues<int>(item1->GetMyScore(), item2->GetMyScore());
       case kListSortScore:
-        return SortListByScore(*item1, *item2);
+        return CompareValues<double>(item1->GetScore(), item2->GetScore());
       case kListSortSeason:
         return SortListBySeason(*item1, *item2, order);
       case kListSortStatus: